@@ -85,7 +85,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -347,7 +347,7 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
+  select_sector (d, sec_no, 1);
   issue_pio_command (c, CMD_READ_SECTOR_RETRY);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
@@ -367,7 +367,7 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
+  select_sector (d, sec_no, 1);
   issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
   if (!wait_while_busy (d))
     PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
@@ -376,24 +376,127 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   lock_release (&c->lock);
 }
 
+/* Maximum number of sectors transferred by one command. */
+#define MAX_CMD_SECTORS 256
+
+/* Returns the next sector-sized buffer of IOV, where *IDX and
+   *OFS track the current piece and the sector within it. */
+static uint8_t *
+next_sector (const struct block_iovec *iov, size_t *idx, size_t *ofs)
+{
+  uint8_t *buffer;
+
+  while (*ofs >= iov[*idx].sector_cnt)
+    {
+      ++*idx;
+      *ofs = 0;
+    }
+  buffer = (uint8_t *) iov[*idx].buffer + *ofs * BLOCK_SECTOR_SIZE;
+  ++*ofs;
+  return buffer;
+}
+
+/* Reads consecutive sectors starting at SEC_NO from disk D into
+   the IOV_CNT pieces of IOV.  Each READ SECTORS command fetches
+   up to MAX_CMD_SECTORS sectors, so a run costs one command and
+   one acquisition of the channel instead of one per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_readv (void *d_, block_sector_t sec_no,
+           const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t left = 0;
+  size_t idx = 0, ofs = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    left += iov[i].sector_cnt;
+
+  lock_acquire (&c->lock);
+  while (left > 0)
+    {
+      size_t cnt = left < MAX_CMD_SECTORS ? left : MAX_CMD_SECTORS;
+
+      select_sector (d, sec_no, cnt);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < cnt; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          input_sector (c, next_sector (iov, &idx, &ofs));
+        }
+      sec_no += cnt;
+      left -= cnt;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes consecutive sectors starting at SEC_NO to disk D from
+   the IOV_CNT pieces of IOV, with one WRITE SECTORS command per
+   MAX_CMD_SECTORS sectors.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_writev (void *d_, block_sector_t sec_no,
+            const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t left = 0;
+  size_t idx = 0, ofs = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    left += iov[i].sector_cnt;
+
+  lock_acquire (&c->lock);
+  while (left > 0)
+    {
+      size_t cnt = left < MAX_CMD_SECTORS ? left : MAX_CMD_SECTORS;
+
+      select_sector (d, sec_no, cnt);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < cnt; i++)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          output_sector (c, next_sector (iov, &idx, &ofs));
+          sema_down (&c->completion_wait);
+        }
+      sec_no += cnt;
+      left -= cnt;
+    }
+  lock_release (&c->lock);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_readv,
+    ide_writev
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the number of sectors to transfer, CNT, to
+   the disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_CMD_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);          /* 256 is written as 0. */
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -317,8 +317,30 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads consecutive sectors starting at SECTOR from partition P
+   into the IOV_CNT pieces of IOV. */
+static void
+partition_readv (void *p_, block_sector_t sector,
+                 const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct partition *p = p_;
+  block_readv (p->block, p->start + sector, iov, iov_cnt);
+}
+
+/* Writes consecutive sectors starting at SECTOR to partition P
+   from the IOV_CNT pieces of IOV. */
+static void
+partition_writev (void *p_, block_sector_t sector,
+                  const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct partition *p = p_;
+  block_writev (p->block, p->start + sector, iov, iov_cnt);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_readv,
+    partition_writev
   };
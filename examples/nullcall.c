@@ -0,0 +1,67 @@
+/* nullcall.c
+
+   Measures the round trip of a system call that does no work,
+   getpid(), through the int $0x30 gate and through the entry
+   path that the C library picks, which is SYSENTER if the
+   processor supports it.
+
+   Usage: nullcall [ITERATIONS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+/* Returns the processor's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Calls getpid() through int $0x30, whatever the C library
+   would use. */
+static inline pid_t
+getpid_int (void)
+{
+  int retval;
+  asm volatile ("pushl %[number]; int $0x30; addl $4, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_GETPID)
+                : "memory");
+  return retval;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 100000;
+  uint64_t start, int_cycles, lib_cycles;
+  int i;
+
+  if (iterations <= 0)
+    {
+      printf ("usage: nullcall [ITERATIONS]\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Let the C library pick its entry path before timing it. */
+  getpid ();
+
+  start = rdtsc ();
+  for (i = 0; i < iterations; i++)
+    getpid_int ();
+  int_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < iterations; i++)
+    getpid ();
+  lib_cycles = rdtsc () - start;
+
+  printf ("int $0x30: %llu cycles per call\n", int_cycles / iterations);
+  printf ("library:   %llu cycles per call\n", lib_cycles / iterations);
+  return EXIT_SUCCESS;
+}
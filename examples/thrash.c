@@ -0,0 +1,54 @@
+/* thrash.c
+
+   Benchmark for paging to swap.
+
+   Repeatedly sweeps over an array larger than physical memory,
+   so that nearly every page it touches has to be brought back
+   in from swap.  Run it with a swap disk, e.g.
+
+        pintos --swap-size=16 -- -q run 'thrash 4'
+
+   and compare the "Paging:" and "Swap:" lines printed at
+   shutdown, which give the number of page faults, the average
+   cycles spent servicing them, and the number of swap device
+   requests. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Size of the array, in bytes.  Should exceed physical memory. */
+#define ARRAY_SIZE (6 * 1024 * 1024)
+
+/* Page size, for touching each page once per sweep. */
+#define PAGE_SIZE 4096
+
+/* Static so that it lives in demand-zero memory, not on the
+   stack. */
+static unsigned char array[ARRAY_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  int passes = argc > 1 ? atoi (argv[1]) : 3;
+  int pass;
+  size_t i;
+
+  /* Dirty every page, so that each one goes to swap. */
+  for (i = 0; i < ARRAY_SIZE; i += PAGE_SIZE)
+    array[i] = i / PAGE_SIZE;
+
+  /* Sweep over the array, checking and updating each page. */
+  for (pass = 0; pass < passes; pass++)
+    for (i = 0; i < ARRAY_SIZE; i += PAGE_SIZE)
+      {
+        if (array[i] != (unsigned char) (i / PAGE_SIZE + pass))
+          {
+            printf ("thrash: bad value at offset %zu in pass %d\n", i, pass);
+            return 1;
+          }
+        array[i]++;
+      }
+
+  printf ("thrash: %d passes over %d kB\n", passes, ARRAY_SIZE / 1024);
+  return 0;
+}
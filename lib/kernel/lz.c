@@ -0,0 +1,169 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Compressed data is a sequence of items, each starting with a
+   control byte C:
+
+   - C < 32: a literal run.  The next C + 1 bytes are copied to
+     the output as they are.
+
+   - C >= 32: a back reference.  L = C >> 5.  If L is 7, the next
+     byte is added to L.  The next byte is the low 8 bits of the
+     offset, whose high 5 bits are the low 5 bits of C.  The L + 2
+     bytes that start OFFSET + 1 bytes back in the output are
+     copied to the output, one at a time, so that a reference may
+     overlap the bytes it produces. */
+
+#define MAX_LITERAL 32                  /* Longest literal run. */
+#define MAX_OFFSET (1 << 13)            /* Farthest back reference. */
+#define MAX_MATCH (7 + 255 + 2)         /* Longest back reference. */
+
+/* The hash table maps a hash of 3 bytes to the position, plus 1,
+   where they last occurred, or 0 if they have not occurred. */
+#define HASH_BITS 12
+#define HASH_SIZE (1 << HASH_BITS)
+
+/* Returns a hash of the 3 bytes at P. */
+static inline unsigned
+hash3 (const uint8_t *p)
+{
+  uint32_t v = (uint32_t) p[0] << 16 | (uint32_t) p[1] << 8 | p[2];
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Compresses the IN_LEN bytes at IN, at most LZ_MAX_INPUT, into
+   the OUT_LEN bytes at OUT, using the LZ_WORK_SIZE bytes at WORK
+   as scratch space.  Returns the size of the compressed data, or
+   0 if it does not fit in OUT_LEN bytes. */
+size_t
+lz_compress (const void *in_, size_t in_len, void *out_, size_t out_len,
+             void *work)
+{
+  const uint8_t *in = in_;
+  const uint8_t *in_end = in + in_len;
+  const uint8_t *ip = in;
+  uint8_t *out = out_;
+  uint8_t *out_end = out + out_len;
+  uint8_t *op = out;
+  uint16_t *table = work;
+  uint8_t *literal = NULL;      /* Control byte of current literal run. */
+
+  ASSERT (in_len <= LZ_MAX_INPUT);
+  ASSERT (HASH_SIZE * sizeof *table <= LZ_WORK_SIZE);
+
+  memset (table, 0, HASH_SIZE * sizeof *table);
+  while (ip < in_end)
+    {
+      size_t len = 0;
+      size_t ofs = 0;
+
+      if (in_end - ip >= 3)
+        {
+          unsigned h = hash3 (ip);
+          const uint8_t *ref = table[h] != 0 ? in + table[h] - 1 : NULL;
+
+          table[h] = ip - in + 1;
+          if (ref != NULL && ip - ref <= MAX_OFFSET
+              && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+            {
+              size_t max = in_end - ip < MAX_MATCH ? in_end - ip : MAX_MATCH;
+
+              len = 3;
+              while (len < max && ref[len] == ip[len])
+                len++;
+              ofs = ip - ref - 1;
+            }
+        }
+
+      if (len == 0)
+        {
+          /* Add a byte to the literal run, starting a new one if
+             necessary. */
+          if (literal == NULL)
+            {
+              if (out_end - op < 2)
+                return 0;
+              literal = op++;
+              *literal = (uint8_t) -1;
+            }
+          else if (op >= out_end)
+            return 0;
+          *op++ = *ip++;
+          if (++*literal == MAX_LITERAL - 1)
+            literal = NULL;
+        }
+      else
+        {
+          size_t l = len - 2;
+
+          if (out_end - op < (l >= 7 ? 3 : 2))
+            return 0;
+          if (l < 7)
+            *op++ = (l << 5) | (ofs >> 8);
+          else
+            {
+              *op++ = (7 << 5) | (ofs >> 8);
+              *op++ = l - 7;
+            }
+          *op++ = ofs & 0xff;
+          ip += len;
+          literal = NULL;
+        }
+    }
+  return op - out;
+}
+
+/* Decompresses the IN_LEN bytes of compressed data at IN into
+   the OUT_LEN bytes at OUT.  Returns the size of the
+   decompressed data, or 0 if the data is corrupt or does not fit
+   in OUT_LEN bytes. */
+size_t
+lz_decompress (const void *in_, size_t in_len, void *out_, size_t out_len)
+{
+  const uint8_t *ip = in_;
+  const uint8_t *in_end = ip + in_len;
+  uint8_t *out = out_;
+  uint8_t *out_end = out + out_len;
+  uint8_t *op = out;
+
+  while (ip < in_end)
+    {
+      unsigned c = *ip++;
+
+      if (c < MAX_LITERAL)
+        {
+          size_t n = c + 1;
+
+          if ((size_t) (in_end - ip) < n || (size_t) (out_end - op) < n)
+            return 0;
+          memcpy (op, ip, n);
+          ip += n;
+          op += n;
+        }
+      else
+        {
+          size_t len = c >> 5;
+          size_t ofs;
+          const uint8_t *ref;
+
+          if (len == 7)
+            {
+              if (ip >= in_end)
+                return 0;
+              len += *ip++;
+            }
+          if (ip >= in_end)
+            return 0;
+          ofs = ((c & 0x1f) << 8 | *ip++) + 1;
+          len += 2;
+
+          if ((size_t) (op - out) < ofs || (size_t) (out_end - op) < len)
+            return 0;
+          for (ref = op - ofs; len > 0; len--)
+            *op++ = *ref++;
+        }
+    }
+  return op - out;
+}
@@ -0,0 +1,25 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+
+/* Fast LZ77-style compression, in the manner of LZF.
+
+   Trades compression ratio for speed: there is no entropy
+   coding, and only the most recent occurrence of each 3-byte
+   sequence is considered for a match.  Data with long runs, such
+   as zeroed buffers, or with repeated strings, such as text,
+   still shrinks a lot. */
+
+/* Bytes of scratch space that lz_compress() needs. */
+#define LZ_WORK_SIZE 8192
+
+/* Largest input that lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *in, size_t in_len, void *out, size_t out_len,
+                    void *work);
+size_t lz_decompress (const void *in, size_t in_len, void *out,
+                      size_t out_len);
+
+#endif /* lib/kernel/lz.h */
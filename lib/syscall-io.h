@@ -0,0 +1,77 @@
+#ifndef __LIB_SYSCALL_IO_H
+#define __LIB_SYSCALL_IO_H
+
+/* Structures that user programs pass to the kernel's I/O system
+   calls, shared by the kernel and the user library so that both
+   sides agree on their layout. */
+
+/* A buffer for readv() and writev(). */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    unsigned iov_len;           /* Length of buffer in bytes. */
+  };
+
+/* Most buffers that readv() or writev() accepts. */
+#define IOV_MAX 64
+
+/* Submission and completion rings for ring_enter().
+
+   A process queues I/O operations by filling in submission
+   entries, then has the kernel carry out all of them with a
+   single ring_enter() call, which posts a completion for each.
+   Both rings have the same number of entries, a power of 2, and
+   are indexed by free-running counters taken modulo that
+   number:
+
+   - The process adds a submission at SQ[SQ_TAIL % ENTRIES] and
+     then increments SQ_TAIL.  The kernel consumes submissions
+     from SQ_HEAD up to SQ_TAIL, incrementing SQ_HEAD.
+
+   - The kernel adds a completion at CQ[CQ_TAIL % ENTRIES] and
+     increments CQ_TAIL.  The process consumes completions from
+     CQ_HEAD up to CQ_TAIL, incrementing CQ_HEAD.
+
+   The kernel stops early when the completion ring is full. */
+
+/* Operations for submission entries. */
+#define RING_OP_NOP 0           /* Nothing; completes with 0. */
+#define RING_OP_READ 1          /* read (FD, BUF, LEN). */
+#define RING_OP_WRITE 2         /* write (FD, BUF, LEN). */
+#define RING_OP_PREAD 3         /* pread (FD, BUF, LEN, OFFSET). */
+#define RING_OP_PWRITE 4        /* pwrite (FD, BUF, LEN, OFFSET). */
+#define RING_OP_OPEN 5          /* open (BUF). */
+#define RING_OP_CLOSE 6         /* close (FD); completes with 0. */
+
+/* A queued operation. */
+struct ring_sqe
+  {
+    int op;                     /* RING_OP_*. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer, or file name to open. */
+    unsigned len;               /* Bytes to read or write. */
+    unsigned offset;            /* Position for pread or pwrite. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* The result of a queued operation. */
+struct ring_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* As the system call would return,
+                                   or -1 for a bad operation or fd. */
+  };
+
+/* A pair of rings. */
+struct ring
+  {
+    unsigned sq_head;           /* Advanced by the kernel. */
+    unsigned sq_tail;           /* Advanced by the process. */
+    unsigned cq_head;           /* Advanced by the process. */
+    unsigned cq_tail;           /* Advanced by the kernel. */
+    unsigned entries;           /* Entries in each ring, a power of 2. */
+    struct ring_sqe *sq;        /* Submission ring. */
+    struct ring_cqe *cq;        /* Completion ring. */
+  };
+
+#endif /* lib/syscall-io.h */
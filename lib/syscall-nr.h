@@ -28,7 +28,18 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Local extensions. */
+    SYS_MEMSTAT,                /* Print kernel memory statistics. */
+    SYS_FORK,                   /* Duplicate the calling process. */
+    SYS_MADVISE,                /* Advise on use of a memory range. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_PREAD,                  /* Read from a file at a given position. */
+    SYS_PWRITE,                 /* Write to a file at a given position. */
+    SYS_RING_ENTER,             /* Carry out queued I/O operations. */
+    SYS_GETPID                  /* Return the caller's process id. */
   };
 
 #endif /* lib/syscall-nr.h */
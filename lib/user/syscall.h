@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include "../syscall-io.h"
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +13,15 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access: no readahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Bring the pages in now. */
+#define MADV_DONTNEED 4         /* Evict the pages now. */
+#define MADV_LOCK 5             /* Keep the pages in memory. */
+#define MADV_UNLOCK 6           /* Undo MADV_LOCK. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -45,4 +55,15 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Local extensions. */
+bool memstat (void);
+pid_t fork (void);
+int madvise (void *addr, unsigned length, int advice);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int ring_enter (struct ring *);
+pid_t getpid (void);
+
 #endif /* lib/user/syscall.h */
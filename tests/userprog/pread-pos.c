@@ -0,0 +1,29 @@
+/* Reads from the middle of a file with pread() and checks that
+   the file position is left alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OFS 100
+#define LEN 40
+
+void
+test_main (void)
+{
+  char buf[LEN];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pread (handle, buf, LEN, OFS) == LEN, "pread %d bytes at %d",
+         LEN, OFS);
+  compare_bytes (buf, sample + OFS, LEN, OFS, "sample.txt");
+  CHECK (tell (handle) == 0, "file position is still 0");
+
+  /* A plain read() must still start at the beginning. */
+  CHECK (read (handle, buf, LEN) == LEN, "read %d bytes", LEN);
+  compare_bytes (buf, sample, LEN, 0, "sample.txt");
+  CHECK (tell (handle) == LEN, "file position is now %d", LEN);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pos) begin
+(pread-pos) open "sample.txt"
+(pread-pos) pread 40 bytes at 100
+(pread-pos) file position is still 0
+(pread-pos) read 40 bytes
+(pread-pos) file position is now 40
+(pread-pos) end
+pread-pos: exit(0)
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Writes the second half of a file with pwrite() and checks that
+   the file position is left alone, so that a plain write() then
+   fills in the first half. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OFS 100
+
+void
+test_main (void)
+{
+  size_t size = sizeof sample - 1;
+  int handle;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (pwrite (handle, sample + OFS, size - OFS, OFS) == (int) (size - OFS),
+         "pwrite at %d", OFS);
+  CHECK (tell (handle) == 0, "file position is still 0");
+  CHECK (write (handle, sample, OFS) == OFS, "write %d bytes", OFS);
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, size);
+}
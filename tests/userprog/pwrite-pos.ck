@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pwrite-pos) begin
+(pwrite-pos) create "test.txt"
+(pwrite-pos) open "test.txt"
+(pwrite-pos) pwrite at 100
+(pwrite-pos) file position is still 0
+(pwrite-pos) write 100 bytes
+(pwrite-pos) close "test.txt"
+(pwrite-pos) open "test.txt" for verification
+(pwrite-pos) verified contents of "test.txt"
+(pwrite-pos) close "test.txt"
+(pwrite-pos) end
+pwrite-pos: exit(0)
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Reads sample.txt into several buffers with one readv() call,
+   more than the file holds, and checks that readv() stops at the
+   end of the file and leaves the last buffer alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PART 100
+
+void
+test_main (void)
+{
+  static char bufs[4][PART];
+  struct iovec iov[4];
+  size_t size = sizeof sample - 1;
+  int handle, byte_cnt, i;
+
+  memset (bufs, 'x', sizeof bufs);
+  for (i = 0; i < 4; i++)
+    {
+      iov[i].iov_base = bufs[i];
+      iov[i].iov_len = PART;
+    }
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  byte_cnt = readv (handle, iov, 4);
+  if (byte_cnt != (int) size)
+    fail ("readv() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes (bufs, sample, size, 0, "sample.txt");
+  CHECK (bufs[3][0] == 'x', "buffer past end of file untouched");
+  CHECK (tell (handle) == size, "file position is at end of file");
+}
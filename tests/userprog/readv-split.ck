@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-split) begin
+(readv-split) open "sample.txt"
+(readv-split) buffer past end of file untouched
+(readv-split) file position is at end of file
+(readv-split) end
+readv-split: exit(0)
+EOF
+pass;
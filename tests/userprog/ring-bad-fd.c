@@ -0,0 +1,35 @@
+/* Submits a read from a bogus file descriptor through
+   ring_enter(), followed by a no-op, and checks that the read
+   completes with -1 without stopping the no-op behind it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ENTRIES 4
+
+static struct ring_sqe sq[ENTRIES];
+static struct ring_cqe cq[ENTRIES];
+
+void
+test_main (void)
+{
+  struct ring ring = { .entries = ENTRIES, .sq = sq, .cq = cq };
+  char buf[16];
+
+  sq[0].op = RING_OP_READ;
+  sq[0].fd = 0x20101234;
+  sq[0].buf = buf;
+  sq[0].len = sizeof buf;
+  sq[0].user_data = 7;
+  sq[1].op = RING_OP_NOP;
+  sq[1].user_data = 8;
+  ring.sq_tail = 2;
+
+  CHECK (ring_enter (&ring) == 2, "ring_enter");
+  CHECK (ring.sq_head == 2 && ring.cq_tail == 2, "both entries consumed");
+  CHECK (cq[0].user_data == 7 && cq[0].result == -1,
+         "read from bad fd completed with -1");
+  CHECK (cq[1].user_data == 8 && cq[1].result == 0,
+         "no-op completed with 0");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-bad-fd) begin
+(ring-bad-fd) ring_enter
+(ring-bad-fd) both entries consumed
+(ring-bad-fd) read from bad fd completed with -1
+(ring-bad-fd) no-op completed with 0
+(ring-bad-fd) end
+ring-bad-fd: exit(0)
+EOF
+pass;
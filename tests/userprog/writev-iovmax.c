@@ -0,0 +1,37 @@
+/* Checks that writev() rejects a negative buffer count and one
+   over IOV_MAX, and accepts exactly IOV_MAX buffers. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PART 2
+
+void
+test_main (void)
+{
+  static struct iovec iov[IOV_MAX + 1];
+  int handle, byte_cnt, i;
+
+  for (i = 0; i < IOV_MAX + 1; i++)
+    {
+      iov[i].iov_base = (char *) sample + i * PART;
+      iov[i].iov_len = PART;
+    }
+
+  CHECK (create ("test.txt", IOV_MAX * PART), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (writev (handle, iov, -1) == -1, "writev with -1 buffers fails");
+  CHECK (writev (handle, iov, IOV_MAX + 1) == -1,
+         "writev with IOV_MAX + 1 buffers fails");
+  CHECK (tell (handle) == 0, "nothing written");
+
+  byte_cnt = writev (handle, iov, IOV_MAX);
+  if (byte_cnt != IOV_MAX * PART)
+    fail ("writev() returned %d instead of %d", byte_cnt, IOV_MAX * PART);
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, IOV_MAX * PART);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(writev-iovmax) begin
+(writev-iovmax) create "test.txt"
+(writev-iovmax) open "test.txt"
+(writev-iovmax) writev with -1 buffers fails
+(writev-iovmax) writev with IOV_MAX + 1 buffers fails
+(writev-iovmax) nothing written
+(writev-iovmax) close "test.txt"
+(writev-iovmax) open "test.txt" for verification
+(writev-iovmax) verified contents of "test.txt"
+(writev-iovmax) close "test.txt"
+(writev-iovmax) end
+writev-iovmax: exit(0)
+EOF
+pass;
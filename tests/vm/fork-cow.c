@@ -0,0 +1,42 @@
+/* Forks a child that overwrites buffers in its data segment,
+   BSS, and stack, and checks that the parent still sees its own
+   copies afterward. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+static char data[SIZE] = "parent data";
+static char bss[SIZE];
+
+void
+test_main (void)
+{
+  char stack[128] = "parent stack";
+  pid_t child;
+
+  memset (bss, 'p', sizeof bss);
+
+  child = fork ();
+  if (child == 0)
+    {
+      memset (data, 'c', sizeof data);
+      memset (bss, 'c', sizeof bss);
+      memset (stack, 'c', sizeof stack);
+      if (data[0] != 'c' || bss[SIZE - 1] != 'c' || stack[0] != 'c')
+        fail ("child does not see its own writes");
+      msg ("child: wrote its copies");
+      exit (0);
+    }
+  if (child < 0)
+    fail ("fork returned %d", child);
+
+  if (wait (child) != 0)
+    fail ("wrong exit code from child");
+  CHECK (!strcmp (data, "parent data"), "data unchanged in parent");
+  CHECK (bss[0] == 'p' && bss[SIZE - 1] == 'p', "bss unchanged in parent");
+  CHECK (!strcmp (stack, "parent stack"), "stack unchanged in parent");
+}
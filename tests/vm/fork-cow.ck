@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) child: wrote its copies
+fork-cow: exit(0)
+(fork-cow) data unchanged in parent
+(fork-cow) bss unchanged in parent
+(fork-cow) stack unchanged in parent
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Forks a child and checks that fork() returns 0 in the child
+   and the child's pid in the parent. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t child = fork ();
+
+  if (child == 0)
+    {
+      msg ("child: fork returned 0");
+      exit (81);
+    }
+  if (child < 0)
+    fail ("fork returned %d", child);
+
+  /* Say nothing until the child is done, so that the output
+     does not depend on which process runs first. */
+  if (wait (child) != 81)
+    fail ("wrong exit code from child");
+  msg ("parent: fork returned child's pid");
+}
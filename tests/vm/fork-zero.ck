@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-zero) begin
+(fork-zero) child: fork returned 0
+fork-zero: exit(81)
+(fork-zero) parent: fork returned child's pid
+(fork-zero) end
+fork-zero: exit(0)
+EOF
+pass;
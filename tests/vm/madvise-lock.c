@@ -0,0 +1,40 @@
+/* Locks a range of pages into memory with madvise(), asks for
+   it to be dropped, unlocks it, and drops it again, checking the
+   return values and that the data survives.  Then checks that a
+   process may not lock 2 MB, more than its share of memory. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define SIZE (8 * PAGE)
+#define BIG (2 * 1024 * 1024)
+
+static char area[BIG + PAGE];
+
+void
+test_main (void)
+{
+  char *buf = (char *) (((uintptr_t) area + PAGE - 1) & ~(PAGE - 1));
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+
+  CHECK (madvise (buf, SIZE, MADV_LOCK) == 0, "lock");
+  CHECK (madvise (buf, SIZE, MADV_DONTNEED) == 0, "drop locked pages");
+  CHECK (madvise (buf, SIZE, MADV_UNLOCK) == 0, "unlock");
+  CHECK (madvise (buf, SIZE, MADV_DONTNEED) == 0, "drop unlocked pages");
+  CHECK (madvise (buf, SIZE, MADV_UNLOCK) == 0,
+         "unlock pages that are not resident");
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu is %d instead of %d", i, buf[i], (int) (i % 251));
+  msg ("data intact");
+
+  CHECK (madvise (buf, BIG, MADV_LOCK) == -1, "lock 2 MB (must fail)");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-lock) begin
+(madvise-lock) lock
+(madvise-lock) drop locked pages
+(madvise-lock) unlock
+(madvise-lock) drop unlocked pages
+(madvise-lock) unlock pages that are not resident
+(madvise-lock) data intact
+(madvise-lock) lock 2 MB (must fail)
+(madvise-lock) end
+madvise-lock: exit(0)
+EOF
+pass;
@@ -0,0 +1,73 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Processor feature flags reported by CPUID leaf 1 in EDX.
+   See [IA32-v2a] "CPUID--CPU Identification". */
+#define CPUID_PSE 0x00000008    /* 4 MB pages (page size extension). */
+#define CPUID_SEP 0x00000800    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE 0x00002000    /* Global pages. */
+
+/* Control register 4 bits.
+   See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010      /* Enable 4 MB pages. */
+#define CR4_PGE 0x00000080      /* Enable global pages. */
+
+/* Returns true if the processor reports all of the CPUID_*
+   feature flags in FEATURES. */
+static inline bool
+cpu_has (uint32_t features)
+{
+  /* See [IA32-v2a] "CPUID--CPU Identification". */
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & features) == features;
+}
+
+/* Model-specific registers that set up SYSENTER.
+   See [IA32-v3a] 5.8.7 "Performing Fast Calls to System
+   Procedures with the SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Stores VALUE into model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  /* See [IA32-v2b] "WRMSR--Write to Model Specific Register". */
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Returns the contents of control register 4. */
+static inline uint32_t
+rcr4 (void)
+{
+  /* See [IA32-v2a] "MOV--Move to/from Control Registers". */
+  uint32_t cr4;
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  return cr4;
+}
+
+/* Stores CR4 into control register 4. */
+static inline void
+lcr4 (uint32_t cr4)
+{
+  /* See [IA32-v2a] "MOV--Move to/from Control Registers". */
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4) : "memory");
+}
+
+/* Returns the processor's time-stamp counter, which counts
+   clock cycles since reset. */
+static inline uint64_t
+rdtsc (void)
+{
+  /* See [IA32-v2b] "RDTSC--Read Time-Stamp Counter". */
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/cpu.h */
@@ -15,13 +15,16 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,6 +40,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -96,8 +104,13 @@ main (void)
 
   /* Initialize memory system. */
   palloc_init (user_page_limit);
+  memtrack_init ();
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
+#ifdef VM
+  frame_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -127,6 +140,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize swap and start estimating working sets. */
+  swap_init ();
+  frame_start_sampler ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -153,13 +172,29 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports 4 MB pages, each 4 MB-aligned chunk of
+   physical memory that lies entirely within RAM is mapped by a
+   single page directory entry, which saves a page table per
+   chunk and a great many TLB entries.  The chunk that contains
+   the kernel's text, and any partial chunk at the end of RAM,
+   still use 4 kB pages, so that the text stays read-only.
+
+   If the CPU supports global pages, all of these mappings are
+   marked global.  They are identical in every page directory,
+   so there is no need for the CR3 load in pagedir_activate() to
+   flush them from the TLB. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  const size_t large_pages = PTSPAN / PGSIZE;
+  bool pse = cpu_has (CPUID_PSE);
+  uint32_t global = cpu_has (CPUID_PGE) ? PTE_G : 0;
+  uint32_t cr4 = rcr4 ();
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,15 +206,33 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && init_ram_pages - page >= large_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true) | global;
+          page += large_pages - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
+  /* Large pages must be enabled before a page directory that
+     uses them is loaded.  See [IA32-v3a] 3.7.3 "Mixing 4-KByte
+     and 4-MByte Pages" and 3.11 "Translation Lookaside Buffers
+     (TLBs)". */
+  if (pse)
+    cr4 |= CR4_PSE;
+  if (global)
+    cr4 |= CR4_PGE;
+  lcr4 (cr4);
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -256,9 +309,29 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-mt"))
+        memtrack_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-pf"))
+        exception_fault_report = true;
+      else if (!strcmp (name, "-pft"))
+        exception_fault_trace = true;
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        page_stack_limit = (size_t) atoi (value) * 1024 * 1024;
+      else if (!strcmp (name, "-fa"))
+        page_fault_around = (size_t) atoi (value);
+      else if (!strcmp (name, "-hp"))
+        page_huge_pages = true;
+      else if (!strcmp (name, "-rss"))
+        frame_rss_limit = (size_t) atoi (value);
+      else if (!strcmp (name, "-ws"))
+        frame_ws_report = true;
+      else if (!strcmp (name, "-zs"))
+        swap_pool_limit = (size_t) atoi (value) * 1024;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -379,8 +452,19 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -mt                Track kernel memory allocations.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -pf                Report each process's page faults at exit.\n"
+          "  -pft               Log every page fault.\n"
+#endif
+#ifdef VM
+          "  -sl=MB             Limit user stacks to MB megabytes (default 8).\n"
+          "  -fa=N              Map up to N cached pages around a fault (default 16).\n"
+          "  -hp                Map large zero-filled regions with 4 MB pages.\n"
+          "  -rss=PAGES         Limit each new process to PAGES resident pages.\n"
+          "  -ws                Report resident and working set sizes at exit.\n"
+          "  -zs=KB             Keep up to KB kB of compressed swap in RAM (default 256).\n"
 #endif
           );
   shutdown_power_off ();
@@ -5,9 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +34,15 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   A multi-page block needs that many physically contiguous free
+   pages, which fragmentation can make impossible to find even
+   when plenty of memory is free.  If the page allocator fails,
+   we fall back to vmalloc_get_multiple(), which maps scattered
+   pages at contiguous virtual addresses.  Such a block can also
+   be grown in place by realloc() by mapping more pages after
+   it. */
 
 /* Descriptor. */
 struct desc
@@ -66,6 +76,9 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static bool extend_big_block (void *, size_t new_size);
+static void *alloc_block (size_t size, const void *site);
+static void *malloc_untracked (size_t size);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -88,6 +101,28 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size)
+{
+  return alloc_block (size, __builtin_return_address (0));
+}
+
+/* Obtains and returns a new block of at least SIZE bytes,
+   attributing it to the code at SITE for memory accounting.
+   Returns a null pointer if memory is not available. */
+static void *
+alloc_block (size_t size, const void *site)
+{
+  void *block = malloc_untracked (size);
+
+  if (memtrack_enabled)
+    memtrack_alloc (MEMTRACK_MALLOC, block, size, site);
+  return block;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes,
+   without recording it for memory accounting.
+   Returns a null pointer if memory is not available. */
+static void *
+malloc_untracked (size_t size)
 {
   struct desc *d;
   struct block *b;
@@ -108,9 +143,16 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && page_cnt > 1)
+        a = vmalloc_get_multiple (0, page_cnt);
       if (a == NULL)
         return NULL;
 
+      /* The caller's block is tracked by itself, so don't also
+         charge the caller for the pages under it. */
+      if (memtrack_enabled)
+        memtrack_disown (a);
+
       /* Initialize the arena to indicate a big block of PAGE_CNT
          pages, and return it. */
       a->magic = ARENA_MAGIC;
@@ -134,6 +176,11 @@ malloc (size_t size)
           return NULL;
         }
 
+      /* The arena will hold other threads' blocks as well, and
+         lives as long as any of them does. */
+      if (memtrack_enabled)
+        memtrack_disown (a);
+
       /* Initialize arena and add its blocks to the free list. */
       a->magic = ARENA_MAGIC;
       a->desc = d;
@@ -167,7 +214,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = alloc_block (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -185,8 +232,34 @@ block_size (void *block)
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Tries to grow BLOCK, which must be a big block, to hold
+   NEW_SIZE bytes without moving it, by taking over the pages
+   that follow its arena.  Returns true if successful, false if
+   BLOCK is not a big block or those pages are not free. */
+static bool
+extend_big_block (void *block, size_t new_size)
+{
+  struct arena *a = block_to_arena (block);
+  size_t page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  bool ok;
+
+  if (a->desc != NULL)
+    return false;
+
+  if (is_vmalloc_vaddr (a))
+    ok = vmalloc_extend (a, a->free_cnt, page_cnt);
+  else
+    ok = palloc_extend_multiple (a, a->free_cnt, page_cnt);
+  if (ok)
+    a->free_cnt = page_cnt;
+  return ok;
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process.  OLD_BLOCK is returned unchanged if
+   it already has room for NEW_SIZE bytes, and a big block is
+   grown in place if the pages after it are free, so that
+   repeatedly growing an array does not copy it every time.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
@@ -201,7 +274,20 @@ realloc (void *old_block, size_t new_size)
     }
   else
     {
-      void *new_block = malloc (new_size);
+      void *new_block;
+
+      /* Keep the block if it is already big enough, or if it is
+         a big block that can be extended in place. */
+      if (old_block != NULL
+          && (new_size <= block_size (old_block)
+              || extend_big_block (old_block, new_size)))
+        {
+          if (memtrack_enabled)
+            memtrack_resize (old_block, new_size);
+          return old_block;
+        }
+
+      new_block = alloc_block (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -224,6 +310,9 @@ free (void *p)
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
 
+      if (memtrack_enabled)
+        memtrack_free (p);
+
       if (d != NULL)
         {
           /* It's a normal block.  We handle it here. */
@@ -257,7 +346,10 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_vaddr (a))
+            vmalloc_free_multiple (a, a->free_cnt);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
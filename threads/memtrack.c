@@ -0,0 +1,357 @@
+#include "threads/memtrack.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Kernel memory accounting.
+
+   When enabled with the -mt kernel command-line option, every
+   block handed out by malloc() and every page group handed out
+   by palloc_get_multiple() is recorded together with the
+   address of the code that asked for it (its "call site") and
+   the thread that was running at the time.  Live bytes and
+   block counts are accumulated per call site, and the blocks a
+   process still holds when it exits can be listed.
+
+   Some memory outlives the thread that happened to allocate it
+   by design, such as a malloc() arena, which holds other
+   threads' blocks too, or a compressed copy of another
+   process's page that was swapped out while this one ran.  Its
+   allocator disowns it with memtrack_disown(), so that it is
+   never listed as a leak, although it still counts toward its
+   call site.
+
+   Call sites are reported as raw code addresses.  Pipe the
+   output through the "backtrace" utility to turn them into
+   function names and line numbers.
+
+   All bookkeeping lives in tables obtained directly from the
+   page allocator at initialization time, so tracking never
+   allocates memory itself.  When a table fills up, further
+   allocations are simply not tracked; the number of those is
+   reported as "dropped".
+
+   palloc_free_page() is called from the scheduler with
+   interrupts off, so the tables are protected by disabling
+   interrupts rather than by a lock. */
+
+/* -mt: Track kernel memory allocations? */
+bool memtrack_enabled;
+
+/* Per-call-site totals. */
+struct site
+  {
+    const void *addr;                   /* Call site, null if unused. */
+    enum memtrack_kind kind;            /* Kind of allocation. */
+    size_t live_bytes;                  /* Bytes currently allocated. */
+    size_t live_cnt;                    /* Blocks currently allocated. */
+    size_t peak_bytes;                  /* Maximum of live_bytes. */
+    unsigned long long total_cnt;       /* Blocks ever allocated. */
+    size_t leak_bytes;                  /* Scratch for memtrack_print_leaks(). */
+    size_t leak_cnt;                    /* Scratch for memtrack_print_leaks(). */
+  };
+
+/* One live allocation. */
+struct record
+  {
+    const void *ptr;                    /* Allocated block, null if unused. */
+    size_t size;                        /* Size in bytes. */
+    struct site *site;                  /* Where it was allocated. */
+    tid_t tid;                          /* Thread that allocated it,
+                                           or TID_ERROR if none. */
+  };
+
+/* Table sizes.  Both tables are open-addressed hash tables with
+   linear probing.  remove_record() relies on RECORD_CNT being a
+   power of 2. */
+#define SITE_PAGES 4
+#define RECORD_PAGES 32
+#define SITE_CNT (SITE_PAGES * PGSIZE / sizeof (struct site))
+#define RECORD_CNT (RECORD_PAGES * PGSIZE / sizeof (struct record))
+
+static struct site *sites;
+static struct record *records;
+static size_t dropped_cnt;
+
+/* Serializes memtrack_print_leaks(), which uses the scratch
+   members of struct site. */
+static struct lock leak_lock;
+
+static const char *kind_names[MEMTRACK_KIND_CNT] = { "malloc", "palloc" };
+
+static size_t hash_ptr (const void *);
+static struct site *find_site (enum memtrack_kind, const void *addr);
+static struct record *find_record (const void *ptr);
+static void remove_record (struct record *);
+
+/* Allocates the tracking tables, if tracking is enabled.  Must
+   be called after palloc_init(). */
+void
+memtrack_init (void)
+{
+  if (!memtrack_enabled)
+    return;
+
+  lock_init (&leak_lock);
+  sites = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, SITE_PAGES);
+  records = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, RECORD_PAGES);
+  printf ("Tracking kernel memory allocations.\n");
+}
+
+/* Records that SIZE bytes at PTR, of the given KIND, were just
+   allocated on behalf of the code at SITE. */
+void
+memtrack_alloc (enum memtrack_kind kind, const void *ptr, size_t size,
+                const void *site)
+{
+  enum intr_level old_level;
+  struct record *r;
+  struct site *s;
+
+  if (records == NULL || ptr == NULL)
+    return;
+
+  old_level = intr_disable ();
+  r = find_record (ptr);
+  s = find_site (kind, site);
+  if (r != NULL && r->ptr == NULL && s != NULL)
+    {
+      r->ptr = ptr;
+      r->size = size;
+      r->site = s;
+      r->tid = thread_current ()->tid;
+
+      s->live_bytes += size;
+      s->live_cnt++;
+      s->total_cnt++;
+      if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+    }
+  else
+    dropped_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Records that the block at PTR now occupies SIZE bytes. */
+void
+memtrack_resize (const void *ptr, size_t size)
+{
+  enum intr_level old_level;
+  struct record *r;
+
+  if (records == NULL || ptr == NULL)
+    return;
+
+  old_level = intr_disable ();
+  r = find_record (ptr);
+  if (r != NULL && r->ptr == ptr)
+    {
+      r->site->live_bytes += size - r->size;
+      r->size = size;
+      if (r->site->live_bytes > r->site->peak_bytes)
+        r->site->peak_bytes = r->site->live_bytes;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the block at PTR was freed.  Blocks that are not
+   being tracked are ignored. */
+void
+memtrack_free (const void *ptr)
+{
+  enum intr_level old_level;
+  struct record *r;
+
+  if (records == NULL || ptr == NULL)
+    return;
+
+  old_level = intr_disable ();
+  r = find_record (ptr);
+  if (r != NULL && r->ptr == ptr)
+    {
+      r->site->live_bytes -= r->size;
+      r->site->live_cnt--;
+      remove_record (r);
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the block at PTR belongs to no thread in
+   particular, so that memtrack_print_leaks() never reports it.
+   Blocks that are not being tracked are ignored. */
+void
+memtrack_disown (const void *ptr)
+{
+  enum intr_level old_level;
+  struct record *r;
+
+  if (records == NULL || ptr == NULL)
+    return;
+
+  old_level = intr_disable ();
+  r = find_record (ptr);
+  if (r != NULL && r->ptr == ptr)
+    r->tid = TID_ERROR;
+  intr_set_level (old_level);
+}
+
+/* Prints live memory per call site. */
+void
+memtrack_print_stats (void)
+{
+  size_t totals[MEMTRACK_KIND_CNT] = { 0, 0 };
+  size_t i;
+
+  if (sites == NULL)
+    return;
+
+  printf ("Memory: live bytes/blocks per call site "
+          "(%zu allocations not tracked):\n", dropped_cnt);
+  for (i = 0; i < SITE_CNT; i++)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct site s = sites[i];
+      intr_set_level (old_level);
+
+      if (s.addr != NULL && s.total_cnt > 0)
+        {
+          printf ("  %s %p: %zu bytes in %zu blocks "
+                  "(peak %zu bytes, %llu allocated)\n",
+                  kind_names[s.kind], s.addr, s.live_bytes, s.live_cnt,
+                  s.peak_bytes, s.total_cnt);
+          totals[s.kind] += s.live_bytes;
+        }
+    }
+  printf ("Memory: %zu bytes live in malloc(), %zu bytes in palloc().\n",
+          totals[MEMTRACK_MALLOC], totals[MEMTRACK_PALLOC]);
+}
+
+/* Prints, per call site, the blocks still allocated that were
+   allocated by thread TID and not disowned since. */
+void
+memtrack_print_leaks (tid_t tid)
+{
+  enum intr_level old_level;
+  size_t leak_bytes = 0;
+  size_t i;
+
+  if (records == NULL)
+    return;
+
+  lock_acquire (&leak_lock);
+
+  old_level = intr_disable ();
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      struct record *r = &records[i];
+      if (r->ptr != NULL && r->tid == tid)
+        {
+          r->site->leak_bytes += r->size;
+          r->site->leak_cnt++;
+          leak_bytes += r->size;
+        }
+    }
+  intr_set_level (old_level);
+
+  if (leak_bytes > 0)
+    printf ("Memory: %zu bytes still held by thread %d:\n", leak_bytes, tid);
+  for (i = 0; i < SITE_CNT; i++)
+    {
+      struct site *s = &sites[i];
+      size_t bytes, cnt;
+
+      old_level = intr_disable ();
+      bytes = s->leak_bytes;
+      cnt = s->leak_cnt;
+      s->leak_bytes = s->leak_cnt = 0;
+      intr_set_level (old_level);
+
+      if (cnt > 0)
+        printf ("  %s %p: %zu bytes in %zu blocks\n",
+                kind_names[s->kind], s->addr, bytes, cnt);
+    }
+
+  lock_release (&leak_lock);
+}
+
+/* Returns a hash of pointer P. */
+static size_t
+hash_ptr (const void *p)
+{
+  uint32_t x = (uintptr_t) p;
+  return (x ^ (x >> 12) ^ (x >> 20)) * 2654435761u;
+}
+
+/* Returns the site entry for ADDR and KIND, creating it if
+   necessary.  Returns a null pointer if the table is full. */
+static struct site *
+find_site (enum memtrack_kind kind, const void *addr)
+{
+  size_t i, n;
+
+  for (i = hash_ptr (addr) % SITE_CNT, n = 0; n < SITE_CNT;
+       i = (i + 1) % SITE_CNT, n++)
+    {
+      struct site *s = &sites[i];
+      if (s->addr == NULL)
+        {
+          s->addr = addr;
+          s->kind = kind;
+          return s;
+        }
+      else if (s->addr == addr && s->kind == kind)
+        return s;
+    }
+  return NULL;
+}
+
+/* Returns the record for PTR, if there is one, otherwise the
+   empty slot where it would be inserted.  Returns a null pointer
+   if PTR is not present and the table is full. */
+static struct record *
+find_record (const void *ptr)
+{
+  size_t i, n;
+
+  for (i = hash_ptr (ptr) % RECORD_CNT, n = 0; n < RECORD_CNT;
+       i = (i + 1) % RECORD_CNT, n++)
+    {
+      struct record *r = &records[i];
+      if (r->ptr == NULL || r->ptr == ptr)
+        return r;
+    }
+  return NULL;
+}
+
+/* Empties record R, moving later records of the same probe
+   sequence back so that find_record() still finds them. */
+static void
+remove_record (struct record *r)
+{
+  size_t hole = r - records;
+  size_t i = hole;
+
+  for (;;)
+    {
+      size_t home;
+
+      i = (i + 1) % RECORD_CNT;
+      if (records[i].ptr == NULL)
+        break;
+
+      /* Move records[i] into the hole unless its home slot lies
+         cyclically in (hole, i]. */
+      home = hash_ptr (records[i].ptr) % RECORD_CNT;
+      if ((i - home) % RECORD_CNT >= (i - hole) % RECORD_CNT)
+        {
+          records[hole] = records[i];
+          hole = i;
+        }
+    }
+  records[hole].ptr = NULL;
+}
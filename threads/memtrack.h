@@ -0,0 +1,30 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/thread.h"
+
+/* Kinds of tracked allocation. */
+enum memtrack_kind
+  {
+    MEMTRACK_MALLOC,            /* malloc(), calloc(), realloc(). */
+    MEMTRACK_PALLOC,            /* palloc_get_page(), palloc_get_multiple(). */
+    MEMTRACK_KIND_CNT           /* Number of kinds. */
+  };
+
+/* -mt: Track kernel memory allocations? */
+extern bool memtrack_enabled;
+
+void memtrack_init (void);
+
+void memtrack_alloc (enum memtrack_kind, const void *, size_t size,
+                     const void *site);
+void memtrack_resize (const void *, size_t size);
+void memtrack_free (const void *);
+void memtrack_disown (const void *);
+
+void memtrack_print_stats (void);
+void memtrack_print_leaks (tid_t);
+
+#endif /* threads/memtrack.h */
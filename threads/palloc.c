@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
+#include "threads/memtrack.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -39,6 +40,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void *get_pages (enum palloc_flags, size_t page_cnt, const void *site);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -69,6 +71,15 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_pages (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Obtains and returns a group of PAGE_CNT contiguous free pages,
+   as palloc_get_multiple(), attributing them to the code at
+   SITE for memory accounting. */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt, const void *site)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
@@ -97,9 +108,52 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
         PANIC ("palloc_get: out of pages");
     }
 
+  if (memtrack_enabled)
+    memtrack_alloc (MEMTRACK_PALLOC, pages, PGSIZE * page_cnt, site);
   return pages;
 }
 
+/* Grows the group of PAGE_CNT pages starting at PAGES, which
+   must have been obtained from palloc_get_multiple(), to
+   NEW_PAGE_CNT pages without moving it.  This succeeds only if
+   the pages that follow the group in its pool are all free, in
+   which case they are claimed and true is returned.  Otherwise
+   returns false and leaves the group unchanged.  The new pages
+   are not zeroed. */
+bool
+palloc_extend_multiple (void *pages, size_t page_cnt, size_t new_page_cnt)
+{
+  struct pool *pool;
+  size_t page_idx, add_cnt;
+  bool ok;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_page_cnt >= page_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    NOT_REACHED ();
+
+  page_idx = pg_no (pages) - pg_no (pool->base);
+  add_cnt = new_page_cnt - page_cnt;
+  if (new_page_cnt > bitmap_size (pool->used_map) - page_idx)
+    return false;
+
+  lock_acquire (&pool->lock);
+  ok = bitmap_none (pool->used_map, page_idx + page_cnt, add_cnt);
+  if (ok)
+    bitmap_set_multiple (pool->used_map, page_idx + page_cnt, add_cnt, true);
+  lock_release (&pool->lock);
+
+  if (ok && memtrack_enabled)
+    memtrack_resize (pages, PGSIZE * new_page_cnt);
+
+  return ok;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -110,7 +164,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  return get_pages (flags, 1, __builtin_return_address (0));
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -133,6 +187,9 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   page_idx = pg_no (pages) - pg_no (pool->base);
 
+  if (memtrack_enabled)
+    memtrack_free (pages);
+
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
@@ -479,9 +479,11 @@ init_thread (struct thread *t, const char *name, int priority)
   t->parent_thread = 0;
 
   //-------------------------
-  list_init(&t->files);
   list_init(&t->children);
   //-------------------------
+#ifdef VM
+  list_init (&t->mappings);
+#endif
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -5,6 +5,13 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
+#ifdef USERPROG
+#include "userprog/exception.h"
+#include "userprog/fdtable.h"
+#endif
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -96,21 +103,6 @@ enum load_status {
   LOAD_FAILED
 };
 
-/**************************************************
- * @name struct file_info
- * @description : used inside the thread struct, to indicate the list of file
- *    file information
- * @attribute int fd: the file descriptor for the file
- * @attribute struct file *fp: a pointer to the file (suitably named fp = file pointer)
- * @attribute struct list_elem fpelem: the element of the list.
- *    used for referencing the list of files inside struct thread
-**************************************************/
-struct file_info {
- int fd;
- struct file *fp;
- struct list_elem fpelem;
-};
-
 /**************************************************
  * @name struct child_process
  * @description : used inside the thread struct, to indicate the list of children
@@ -158,8 +150,8 @@ struct process_info {
  * @attribute struct list children: a list of children threads. Can access the individual
  *    children using the list.h functions (which retrieves the struct child_process)
  * @attribute struct thread *parent_thread: a thread containing the parent thread.
- * @attribute struct list files: a list of files. Can access the individual files
- *    using the list.h functions (which retrieves the struct file_info).
+ * @attribute struct fd_table files: the open files, indexed by file descriptor
+ *    (see userprog/fdtable.h).
 **************************************************/
 struct thread
   {
@@ -177,7 +169,6 @@ struct thread
     struct process_info *parent_info;   /* Metadata for a process */
     struct list children;
     struct thread *parent_thread;
-    struct list files;
 
     //-------------------------------------------------------
 
@@ -187,6 +178,39 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+
+    /* Owned by userprog/syscall.c. */
+    struct fd_table files;              /* Open files. */
+
+    /* Owned by userprog/exception.c. */
+    unsigned fault_cnt[FAULT_TYPE_CNT]; /* Page faults by type. */
+    uint64_t fault_cycles;              /* Time spent on page faults. */
+#endif
+
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, kept open for
+                                           lazy loading. */
+
+    void *user_esp;                     /* User stack pointer on entry
+                                           to the kernel, for growing
+                                           the stack. */
+    size_t locked_cnt;                  /* Pages locked with
+                                           MADV_LOCK. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+
+    /* Owned by vm/frame.c. */
+    size_t rss;                         /* Pages with a frame. */
+    size_t rss_peak;                    /* Largest RSS so far. */
+    size_t rss_limit;                   /* RSS limit, or 0 for none. */
+    size_t wss;                         /* Estimated working set size,
+                                           in pages. */
+    size_t wss_sample;                  /* Pages referenced so far in
+                                           the current interval. */
 #endif
 
     /* Owned by thread.c. */
@@ -0,0 +1,242 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include "threads/init.h"
+#include "threads/memtrack.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually mapped page allocator.
+
+   palloc_get_multiple() can only satisfy a request for several
+   pages if that many physically contiguous pages are free in
+   the kernel pool, which stops being true long before the pool
+   is actually exhausted.  This allocator instead takes single
+   pages from the kernel pool, wherever they happen to be, and
+   maps them side by side into a dedicated range of kernel
+   virtual memory starting at VMALLOC_START.
+
+   The page tables that cover the range are allocated once, at
+   initialization time, and installed in init_page_dir.  Every
+   page directory created afterward by pagedir_create() copies
+   those page directory entries, so all of them share the same
+   page tables, and a mapping added or removed here is
+   immediately visible in every address space.
+
+   Memory returned by this allocator is not part of the 1:1
+   physical mapping, so vtop() must not be applied to it. */
+
+/* Number of pages in the vmalloc range. */
+#define VMALLOC_PAGES (VMALLOC_PT_CNT * (PTSPAN / PGSIZE))
+
+/* Page tables that map the vmalloc range. */
+static uint32_t *vmalloc_pts[VMALLOC_PT_CNT];
+
+/* Bitmap of in-use pages in the vmalloc range. */
+static struct bitmap *vmalloc_map;
+static struct lock vmalloc_lock;
+
+static uint32_t *lookup_pte (size_t page_idx);
+static void unmap_pages (size_t page_idx, size_t page_cnt);
+static bool map_pages (enum palloc_flags, size_t page_idx, size_t page_cnt);
+
+/* Initializes the vmalloc allocator.  Must be called after
+   paging_init() and before any process page directory is
+   created, so that the page tables installed here are shared by
+   every address space. */
+void
+vmalloc_init (void)
+{
+  size_t i;
+
+  ASSERT (init_page_dir != NULL);
+  ASSERT ((uint8_t *) ptov (init_ram_pages * PGSIZE)
+          <= (uint8_t *) VMALLOC_START);
+  ASSERT (pg_ofs (VMALLOC_START) == 0 && pt_no (VMALLOC_START) == 0);
+
+  for (i = 0; i < VMALLOC_PT_CNT; i++)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      uint32_t *pde = init_page_dir + pd_no (VMALLOC_START) + i;
+
+      ASSERT (*pde == 0);
+      *pde = pde_create (pt);
+      vmalloc_pts[i] = pt;
+    }
+
+  lock_init (&vmalloc_lock);
+  vmalloc_map = bitmap_create (VMALLOC_PAGES);
+  if (vmalloc_map == NULL)
+    PANIC ("vmalloc: out of memory for bitmap");
+}
+
+/* Obtains PAGE_CNT pages from the kernel pool, not necessarily
+   physically contiguous, maps them at consecutive kernel virtual
+   addresses, and returns the first one.  FLAGS are interpreted
+   as by palloc_get_multiple(), except that PAL_USER is not
+   allowed.  Returns a null pointer if the kernel pool or the
+   vmalloc range is exhausted, unless PAL_ASSERT is set, in which
+   case the kernel panics. */
+void *
+vmalloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  size_t page_idx;
+
+  ASSERT ((flags & PAL_USER) == 0);
+
+  if (page_cnt == 0 || vmalloc_map == NULL)
+    return NULL;
+
+  lock_acquire (&vmalloc_lock);
+  page_idx = bitmap_scan_and_flip (vmalloc_map, 0, page_cnt, false);
+  lock_release (&vmalloc_lock);
+
+  if (page_idx != BITMAP_ERROR && !map_pages (flags, page_idx, page_cnt))
+    {
+      lock_acquire (&vmalloc_lock);
+      bitmap_set_multiple (vmalloc_map, page_idx, page_cnt, false);
+      lock_release (&vmalloc_lock);
+      page_idx = BITMAP_ERROR;
+    }
+
+  if (page_idx == BITMAP_ERROR)
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("vmalloc: out of pages");
+      return NULL;
+    }
+  return (uint8_t *) VMALLOC_START + page_idx * PGSIZE;
+}
+
+/* Grows the PAGE_CNT-page allocation at PAGES, which must have
+   been obtained from vmalloc_get_multiple(), to NEW_PAGE_CNT
+   pages without moving it, by mapping fresh pages right after
+   it.  Returns true if successful, false if the virtual pages
+   that follow are in use or memory is exhausted, in which case
+   the allocation is left unchanged. */
+bool
+vmalloc_extend (void *pages, size_t page_cnt, size_t new_page_cnt)
+{
+  size_t page_idx, add_idx, add_cnt;
+  bool ok;
+
+  ASSERT (is_vmalloc_vaddr (pages));
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_page_cnt >= page_cnt);
+
+  page_idx = pg_no (pages) - pg_no (VMALLOC_START);
+  add_idx = page_idx + page_cnt;
+  add_cnt = new_page_cnt - page_cnt;
+  if (add_cnt == 0)
+    return true;
+  if (new_page_cnt > VMALLOC_PAGES - page_idx)
+    return false;
+
+  lock_acquire (&vmalloc_lock);
+  ok = bitmap_none (vmalloc_map, add_idx, add_cnt);
+  if (ok)
+    bitmap_set_multiple (vmalloc_map, add_idx, add_cnt, true);
+  lock_release (&vmalloc_lock);
+
+  if (ok && !map_pages (0, add_idx, add_cnt))
+    {
+      lock_acquire (&vmalloc_lock);
+      bitmap_set_multiple (vmalloc_map, add_idx, add_cnt, false);
+      lock_release (&vmalloc_lock);
+      ok = false;
+    }
+  return ok;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES, which must have
+   been obtained from vmalloc_get_multiple(). */
+void
+vmalloc_free_multiple (void *pages, size_t page_cnt)
+{
+  size_t page_idx;
+
+  if (pages == NULL || page_cnt == 0)
+    return;
+
+  ASSERT (is_vmalloc_vaddr (pages));
+  ASSERT (pg_ofs (pages) == 0);
+
+  page_idx = pg_no (pages) - pg_no (VMALLOC_START);
+  unmap_pages (page_idx, page_cnt);
+
+  lock_acquire (&vmalloc_lock);
+  ASSERT (bitmap_all (vmalloc_map, page_idx, page_cnt));
+  bitmap_set_multiple (vmalloc_map, page_idx, page_cnt, false);
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns true if VADDR lies within the vmalloc range. */
+bool
+is_vmalloc_vaddr (const void *vaddr)
+{
+  uintptr_t start = (uintptr_t) VMALLOC_START;
+  return (uintptr_t) vaddr >= start
+         && (uintptr_t) vaddr - start < (uintptr_t) VMALLOC_PAGES * PGSIZE;
+}
+
+/* Returns the page table entry for the PAGE_IDX'th page of the
+   vmalloc range. */
+static uint32_t *
+lookup_pte (size_t page_idx)
+{
+  ASSERT (page_idx < VMALLOC_PAGES);
+  return &vmalloc_pts[page_idx / (PTSPAN / PGSIZE)][page_idx
+                                                    % (PTSPAN / PGSIZE)];
+}
+
+/* Maps a freshly allocated kernel page at each of the PAGE_CNT
+   vmalloc pages starting at PAGE_IDX, which must be reserved in
+   vmalloc_map and currently unmapped.  Returns true if
+   successful.  On failure, nothing remains mapped. */
+static bool
+map_pages (enum palloc_flags flags, size_t page_idx, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *kpage = palloc_get_page (flags & PAL_ZERO);
+      uint32_t *pte = lookup_pte (page_idx + i);
+
+      if (kpage == NULL)
+        {
+          unmap_pages (page_idx, i);
+          return false;
+        }
+      /* malloc(), the only user, tracks the block itself. */
+      if (memtrack_enabled)
+        memtrack_disown (kpage);
+      ASSERT (*pte == 0);
+      *pte = pte_create_kernel (kpage, true);
+    }
+  return true;
+}
+
+/* Unmaps the PAGE_CNT vmalloc pages starting at PAGE_IDX and
+   returns the kernel pages behind them to the page allocator. */
+static void
+unmap_pages (size_t page_idx, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint32_t *pte = lookup_pte (page_idx + i);
+      void *vaddr = (uint8_t *) VMALLOC_START + (page_idx + i) * PGSIZE;
+
+      ASSERT (*pte & PTE_P);
+      palloc_free_page (pte_get_page (*pte));
+      *pte = 0;
+
+      /* The stale translation may be cached in the TLB.  See
+         [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+/* Kernel virtual range used for virtually contiguous,
+   physically discontiguous allocations.  It lies well above the
+   1:1 mapping of physical memory, which the loader caps at
+   64 MB. */
+#define VMALLOC_START ((void *) 0xf0000000)  /* First vmalloc page. */
+#define VMALLOC_PT_CNT 4                     /* Page tables, 4 MB each. */
+
+void vmalloc_init (void);
+void *vmalloc_get_multiple (enum palloc_flags, size_t page_cnt);
+bool vmalloc_extend (void *pages, size_t page_cnt, size_t new_page_cnt);
+void vmalloc_free_multiple (void *pages, size_t page_cnt);
+bool is_vmalloc_vaddr (const void *);
+
+#endif /* threads/vmalloc.h */
@@ -2,14 +2,42 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/uaccess.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Page fault error code bits that describe the cause of the exception.  */
+#define PF_P 0x1    /* 0: not-present page. 1: access rights violation. */
+#define PF_W 0x2    /* 0: read, 1: write. */
+#define PF_U 0x4    /* 0: kernel, 1: user process. */
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Page faults of each type, and the time spent handling them in
+   CPU cycles. */
+static unsigned long long fault_type_cnt[FAULT_TYPE_CNT];
+static unsigned long long fault_type_cycles[FAULT_TYPE_CNT];
+
+/* Names of fault types, for printing. */
+static const char *fault_type_names[FAULT_TYPE_CNT] =
+  {"file", "zero", "cow", "swap", "stack", "minor", "fatal"};
+
+/* -pf: Report each process's page faults at exit? */
+bool exception_fault_report;
+
+/* -pft: Log every page fault? */
+bool exception_fault_trace;
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void record_fault (const void *fault_addr, enum fault_type,
+                          uint64_t start);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -64,7 +92,31 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
+  int type;
+
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+  for (type = 0; type < FAULT_TYPE_CNT; type++)
+    if (fault_type_cnt[type] > 0)
+      printf ("Exception: %llu %s faults (%llu cycles each)\n",
+              fault_type_cnt[type], fault_type_names[type],
+              fault_type_cycles[type] / fault_type_cnt[type]);
+}
+
+/* Prints the page faults that thread T has taken, by type. */
+void
+exception_print_faults (const struct thread *t)
+{
+  unsigned long long cnt = 0;
+  int type;
+
+  printf ("%s: page faults:", t->name);
+  for (type = 0; type < FAULT_TYPE_CNT; type++)
+    {
+      printf ("%s %u %s", type > 0 ? "," : "", t->fault_cnt[type],
+              fault_type_names[type]);
+      cnt += t->fault_cnt[type];
+    }
+  printf (" (%llu cycles each)\n", cnt > 0 ? t->fault_cycles / cnt : 0);
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -122,10 +174,14 @@ kill (struct intr_frame *f)
 static void
 page_fault (struct intr_frame *f) 
 {
+  uint64_t start = rdtsc ();
   bool not_present;  /* True: not-present page, false: writing r/o page. */
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+#ifdef VM
+  enum fault_type type;
+#endif
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -148,6 +204,44 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* A user page that is not present may simply not have been
+     loaded yet, or may be the next page of a growing stack.
+     This also covers the kernel touching user memory on the
+     process's behalf, e.g. in a system call, in which case the
+     user stack pointer is the one saved on entry. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+      if (page_load (fault_addr, write, &type))
+        {
+          record_fault (fault_addr, type, start);
+          return;
+        }
+      if (page_grow_stack (fault_addr, esp)
+          && page_load (fault_addr, write, &type))
+        {
+          record_fault (fault_addr, FAULT_STACK, start);
+          return;
+        }
+    }
+
+  /* A write to a present, read-only user page may be the first
+     write to a page shared copy-on-write since fork(). */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_copy_on_write (fault_addr))
+    {
+      record_fault (fault_addr, FAULT_COW, start);
+      return;
+    }
+#endif
+  record_fault (fault_addr, FAULT_FATAL, start);
+
+  /* The kernel may have faulted copying to or from a bad user
+     address on behalf of a system call, which then fails. */
+  if (!user && uaccess_fixup (f))
+    return;
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -159,3 +253,21 @@ page_fault (struct intr_frame *f)
   kill (f);
 }
 
+
+/* Accounts for a page fault at FAULT_ADDR of the given TYPE,
+   whose handling started at time-stamp counter value START, to
+   the system and the current process, and logs it with -pft. */
+static void
+record_fault (const void *fault_addr, enum fault_type type, uint64_t start)
+{
+  struct thread *t = thread_current ();
+  uint64_t cycles = rdtsc () - start;
+
+  fault_type_cnt[type]++;
+  fault_type_cycles[type] += cycles;
+  t->fault_cnt[type]++;
+  t->fault_cycles += cycles;
+  if (exception_fault_trace)
+    printf ("page fault: pid %d addr %p type %s cycles %"PRIu64"\n",
+            t->tid, fault_addr, fault_type_names[type], cycles);
+}
@@ -1,12 +1,31 @@
 #ifndef USERPROG_EXCEPTION_H
 #define USERPROG_EXCEPTION_H
 
-/* Page fault error code bits that describe the cause of the exception.  */
-#define PF_P 0x1    /* 0: not-present page. 1: access rights violation. */
-#define PF_W 0x2    /* 0: read, 1: write. */
-#define PF_U 0x4    /* 0: kernel, 1: user process. */
+#include <stdbool.h>
+
+/* Kinds of page faults, by how they were resolved. */
+enum fault_type
+  {
+    FAULT_FILE,     /* Page loaded from its file, or the page cache. */
+    FAULT_ZERO,     /* Zero-filled page. */
+    FAULT_COW,      /* Write to a page shared copy-on-write. */
+    FAULT_SWAP,     /* Page read back from swap. */
+    FAULT_STACK,    /* New page of a growing stack. */
+    FAULT_MINOR,    /* Page was already in memory. */
+    FAULT_FATAL,    /* Invalid access. */
+    FAULT_TYPE_CNT
+  };
+
+struct thread;
+
+/* -pf: Report each process's page faults at exit? */
+extern bool exception_fault_report;
+
+/* -pft: Log every page fault? */
+extern bool exception_fault_trace;
 
 void exception_init (void);
 void exception_print_stats (void);
+void exception_print_faults (const struct thread *);
 
 #endif /* userprog/exception.h */
@@ -0,0 +1,147 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+
+/* File descriptor table.
+
+   File descriptors index an array of open files, so looking one
+   up takes constant time.  A bitmap records which descriptors
+   are taken, so that a new file gets the lowest free one, as in
+   Unix.  Descriptors 0 and 1 stand for the console and are
+   always taken.  The table starts out empty and doubles in size
+   whenever it fills up. */
+
+/* Descriptors reserved for the console. */
+#define FIRST_FD 2
+
+/* Initial number of descriptors in a table. */
+#define INITIAL_SIZE 16
+
+/* Enlarges table T to hold at least SIZE descriptors.  Returns
+   true if successful, false on memory allocation failure, in
+   which case T is unchanged. */
+static bool
+grow (struct fd_table *t, size_t size)
+{
+  struct file **files;
+  struct bitmap *used;
+  size_t new_size;
+  size_t fd;
+
+  new_size = t->size > 0 ? t->size : INITIAL_SIZE;
+  while (new_size < size)
+    new_size *= 2;
+  if (new_size == t->size)
+    return true;
+
+  files = realloc (t->files, new_size * sizeof *files);
+  if (files == NULL)
+    return false;
+  t->files = files;
+  memset (files + t->size, 0, (new_size - t->size) * sizeof *files);
+
+  used = bitmap_create (new_size);
+  if (used == NULL)
+    return false;
+  bitmap_set_multiple (used, 0, FIRST_FD, true);
+  for (fd = FIRST_FD; fd < t->size; fd++)
+    bitmap_set (used, fd, bitmap_test (t->used, fd));
+  bitmap_destroy (t->used);
+  t->used = used;
+  t->size = new_size;
+  return true;
+}
+
+/* Adds FILE to table T under the lowest free file descriptor and
+   returns the descriptor, or -1 on memory allocation failure. */
+int
+fd_table_add (struct fd_table *t, struct file *file)
+{
+  size_t fd;
+
+  ASSERT (file != NULL);
+
+  fd = t->used != NULL ? bitmap_scan_and_flip (t->used, 0, t->size, false)
+                       : BITMAP_ERROR;
+  if (fd == BITMAP_ERROR)
+    {
+      fd = t->size > 0 ? t->size : FIRST_FD;
+      if (!grow (t, fd + 1))
+        return -1;
+      bitmap_mark (t->used, fd);
+    }
+  t->files[fd] = file;
+  return fd;
+}
+
+/* Returns the file open under descriptor FD in table T, or a
+   null pointer if there is none. */
+struct file *
+fd_table_get (const struct fd_table *t, int fd)
+{
+  return fd >= FIRST_FD && (size_t) fd < t->size ? t->files[fd] : NULL;
+}
+
+/* Removes the file open under descriptor FD from table T, which
+   frees FD for reuse, and returns the file, which the caller
+   should close.  Returns a null pointer if no file is open under
+   FD. */
+struct file *
+fd_table_remove (struct fd_table *t, int fd)
+{
+  struct file *file = fd_table_get (t, fd);
+
+  if (file != NULL)
+    {
+      t->files[fd] = NULL;
+      bitmap_reset (t->used, fd);
+    }
+  return file;
+}
+
+/* Fills table T, which must be empty, with a new handle for each
+   of the files open in table FROM, under the same descriptor and
+   at the same position.  Returns true if successful, false on
+   failure, in which case T holds some of the files and must
+   still be destroyed. */
+bool
+fd_table_copy (struct fd_table *t, const struct fd_table *from)
+{
+  size_t fd;
+
+  ASSERT (t->size == 0);
+
+  if (from->size == 0)
+    return true;
+  if (!grow (t, from->size))
+    return false;
+  for (fd = FIRST_FD; fd < from->size; fd++)
+    if (from->files[fd] != NULL)
+      {
+        struct file *file = file_reopen (from->files[fd]);
+        if (file == NULL)
+          return false;
+        file_seek (file, file_tell (from->files[fd]));
+        t->files[fd] = file;
+        bitmap_mark (t->used, fd);
+      }
+  return true;
+}
+
+/* Closes all the files in table T and frees its memory, leaving
+   it empty. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  size_t fd;
+
+  for (fd = FIRST_FD; fd < t->size; fd++)
+    if (t->files[fd] != NULL)
+      file_close (t->files[fd]);
+  free (t->files);
+  bitmap_destroy (t->used);
+  memset (t, 0, sizeof *t);
+}
@@ -0,0 +1,26 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+
+/* A process's open files, indexed by file descriptor.
+
+   An all-zero fd_table is a valid, empty table, so a new
+   thread's table needs no initialization. */
+struct fd_table
+  {
+    struct file **files;        /* Open files, null where FD is free. */
+    struct bitmap *used;        /* Which FDs are taken. */
+    size_t size;                /* Number of elements in FILES. */
+  };
+
+int fd_table_add (struct fd_table *, struct file *);
+struct file *fd_table_get (const struct fd_table *, int fd);
+struct file *fd_table_remove (struct fd_table *, int fd);
+bool fd_table_copy (struct fd_table *, const struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+
+#endif /* userprog/fdtable.h */
@@ -1,11 +1,17 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Statistics. */
+static long long pd_load_cnt;   /* # of page directory loads. */
+static long long pd_skip_cnt;   /* # of loads skipped by pagedir_switch(). */
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
@@ -34,7 +40,7 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & PTE_P) && !(*pde & PTE_PS))
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -49,6 +55,11 @@ pagedir_destroy (uint32_t *pd)
 
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
+   If VADDR is part of a 4 MB page, returns the address of the
+   page directory entry that maps the 4 MB page instead.  Its
+   P, W, U, A and D bits are in the same places as in a PTE, so
+   callers that only look at or change those bits need not care,
+   but they apply to the whole 4 MB page.
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
@@ -63,9 +74,18 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   /* Shouldn't create new kernel virtual mappings. */
   ASSERT (!create || is_user_vaddr (vaddr));
 
+  /* A 4 MB page that has been unmapped gives way to a page
+     table, if one is needed. */
+  pde = pd + pd_no (vaddr);
+  if (*pde & PTE_PS)
+    {
+      if (!create || (*pde & PTE_P))
+        return pde;
+      *pde = 0;
+    }
+
   /* Check for a page table for VADDR.
      If one is missing, create one if requested. */
-  pde = pd + pd_no (vaddr);
   if (*pde == 0) 
     {
       if (create)
@@ -118,6 +138,89 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Adds a mapping in page directory PD from the 4 MB of user
+   virtual memory starting at UPAGE to the 4 MB of physical
+   memory starting at kernel virtual address KPAGE, as a single
+   large page.  Both must be 4 MB-aligned, and none of the pages
+   in the range may be mapped.  If WRITABLE is true, the memory
+   is read/write; otherwise it is read-only.
+   Returns true if successful, false if the CPU does not support
+   large pages. */
+bool
+pagedir_set_huge_page (uint32_t *pd, void *upage, void *kpage,
+                       bool writable)
+{
+  uint32_t *pde;
+
+  ASSERT (((uintptr_t) upage & ~PDMASK) == 0);
+  ASSERT (((uintptr_t) kpage & ~PDMASK) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages);
+  ASSERT (pd != init_page_dir);
+
+  if (!(rcr4 () & CR4_PSE))
+    return false;
+
+  /* A page table left over from earlier mappings in the range
+     maps nothing any more and can go. */
+  pde = pd + pd_no (upage);
+  if ((*pde & PTE_P) && !(*pde & PTE_PS))
+    {
+      uint32_t *pt = pde_get_pt (*pde);
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *pt; i++)
+        ASSERT ((pt[i] & PTE_P) == 0);
+      palloc_free_page (pt);
+    }
+  else
+    ASSERT ((*pde & PTE_P) == 0);
+
+  *pde = pde_create_large (kpage, writable) | PTE_U;
+  invalidate_pagedir (pd);
+  return true;
+}
+
+/* If user virtual page UPAGE is part of a 4 MB page in PD,
+   replaces the 4 MB page by a page table that maps the same
+   memory 4 kB at a time, each page inheriting the 4 MB page's
+   flags, so that the pages can be unmapped one by one.  Returns
+   true if successful, or if UPAGE is not part of a 4 MB page,
+   false if memory allocation failed. */
+bool
+pagedir_split (uint32_t *pd, const void *upage)
+{
+  uint32_t *pde, *pt;
+  uint8_t *kpage;
+  uint32_t flags;
+  size_t i;
+
+  ASSERT (is_user_vaddr (upage));
+
+  pde = pd + pd_no (upage);
+  if (!(*pde & PTE_PS))
+    return true;
+
+  pt = palloc_get_page (0);
+  if (pt == NULL)
+    return false;
+  kpage = pde_get_large_page (*pde);
+  flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    pt[i] = vtop (kpage + i * PGSIZE) | flags;
+  *pde = pde_create (pt);
+  invalidate_pagedir (pd);
+  return true;
+}
+
+/* Returns true if user virtual page UPAGE is part of a 4 MB page
+   in PD. */
+bool
+pagedir_is_huge (uint32_t *pd, const void *upage)
+{
+  return (pd[pd_no (upage)] & PTE_PS) != 0;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -130,16 +233,21 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   ASSERT (is_user_vaddr (uaddr));
   
   pte = lookup_page (pd, uaddr, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
-    return pte_get_page (*pte) + pg_ofs (uaddr);
-  else
+  if (pte == NULL || (*pte & PTE_P) == 0)
     return NULL;
+  else if (pagedir_is_huge (pd, uaddr))
+    return (uint8_t *) pde_get_large_page (*pte)
+           + ((uintptr_t) uaddr & ~PDMASK);
+  else
+    return pte_get_page (*pte) + pg_ofs (uaddr);
 }
 
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
-   UPAGE need not be mapped. */
+   UPAGE need not be mapped.  If it is part of a 4 MB page, the
+   whole 4 MB page is unmapped; use pagedir_split() first to
+   unmap only UPAGE. */
 void
 pagedir_clear_page (uint32_t *pd, void *upage) 
 {
@@ -156,6 +264,15 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD allows
+   writes.  Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_W) != 0;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -215,7 +332,10 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register.  This flushes the TLB of every translation except
+   the global ones, which paging_init() uses for the kernel's
+   mapping of physical memory, so kernel TLB entries survive a
+   switch between processes. */
 void
 pagedir_activate (uint32_t *pd) 
 {
@@ -228,6 +348,30 @@ pagedir_activate (uint32_t *pd)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  pd_load_cnt++;
+}
+
+/* Makes PD, the page directory of a thread being switched to,
+   active, unless that would be pointless.  If PD is already
+   active, there is nothing to do.  If PD is null, the thread is
+   a kernel thread, which never touches user memory, so it simply
+   keeps running on whatever page directory is loaded ("lazy
+   TLB").  Either way, the TLB keeps its contents. */
+void
+pagedir_switch (uint32_t *pd)
+{
+  if (pd == NULL || pd == active_pd ())
+    pd_skip_cnt++;
+  else
+    pagedir_activate (pd);
+}
+
+/* Prints page directory statistics. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Paging: %lld page directory loads, %lld skipped\n",
+          pd_load_cnt, pd_skip_cnt);
 }
 
 /* Returns the currently active page directory. */
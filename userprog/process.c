@@ -2,6 +2,12 @@
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static void report_load (bool success);
+static void release_children (void);
+static thread_action_func orphan_child;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -65,7 +71,6 @@ start_process (void *file_name_)
   char *file_name = file_name_;
   struct intr_frame if_;
   bool success;
-  struct thread *child_thread = thread_current();
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -74,7 +79,32 @@ start_process (void *file_name_)
   if_.eflags = FLAG_IF | FLAG_MBS;
 
   success = load (file_name, &if_.eip, &if_.esp);
+  report_load (success);
+
+  /* If load failed, quit. */
+  palloc_free_page (file_name);
+  if (!success){
+    thread_exit();
+  }
+
 
+  /* Start the user process by simulating a return from an
+     interrupt, implemented by intr_exit (in
+     threads/intr-stubs.S).  Because intr_exit takes all of its
+     arguments on the stack in the form of a `struct intr_frame',
+     we just point the stack pointer (%esp) to our stack frame
+     and jump to it. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Tells the current thread's parent, which is waiting in
+   process_execute(), whether the new process
+   was set up successfully. */
+static void
+report_load (bool success)
+{
+  struct thread *child_thread = thread_current();
   struct thread *p = child_thread->parent_thread;
 
   /*iteration on the parents child list
@@ -92,26 +122,119 @@ start_process (void *file_name_)
           sema_up(&cp->loading);
         }
     }
+}
 
+#ifdef VM
+/* What process_fork() passes to start_fork(). */
+struct fork_args
+  {
+    struct intr_frame *if_;             /* Parent's interrupt frame. */
+    struct child_process *record;       /* Parent's record of the child. */
+  };
 
+/* Creates a child process that is a copy of the current one,
+   which entered the kernel with interrupt frame IF_.  The child
+   shares the parent's memory copy-on-write (see vm/page.c) and
+   gets its own handle for each of the parent's open files, at
+   the same position.  File mappings are not inherited.  In the
+   child, the system call returns 0.  Returns the child's thread
+   id, or TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct thread *parent_thread = thread_current();
+  struct fork_args args;
+  struct child_process *c;
+  tid_t child_id;
 
-  /* If load failed, quit. */
-  palloc_free_page (file_name);
-  if (!success){
-    thread_exit();
-  }
+  /* The child looks for this record to report that it has copied
+     the parent, so it must be in place before the child runs. */
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return TID_ERROR;
+  memset (c, 0, sizeof *c);
+  sema_init (&c->loading, 0);
+  sema_init (&c->alive, 0);
+  c->pid = TID_ERROR;
+  list_push_back (&parent_thread->children, &c->c_elem);
 
+  args.if_ = if_;
+  args.record = c;
+  child_id = thread_create (parent_thread->name, PRI_DEFAULT, start_fork, &args);
+  if (child_id == TID_ERROR)
+    {
+      list_remove (&c->c_elem);
+      free (c);
+      return TID_ERROR;
+    }
 
-  /* Start the user process by simulating a return from an
-     interrupt, implemented by intr_exit (in
-     threads/intr-stubs.S).  Because intr_exit takes all of its
-     arguments on the stack in the form of a `struct intr_frame',
-     we just point the stack pointer (%esp) to our stack frame
-     and jump to it. */
-  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  /* Copy-on-write relies on the parent not running user code
+     until the child has copied IF_ and the parent's address
+     space, so wait for the child to report. */
+  sema_down (&c->loading);
+
+  if (c->load_status == LOAD_FAILED)
+    {
+      list_remove (&c->c_elem);
+      free (c);
+      return TID_ERROR;
+    }
+  return child_id;
+}
+
+/* A thread function that turns the new thread into a copy of its
+   parent, which is waiting in process_fork() with the
+   `struct fork_args' ARGS_, and starts it running. */
+static void
+start_fork (void *args_)
+{
+  struct fork_args *args = args_;
+  struct child_process *c = args->record;
+  struct thread *t = thread_current ();
+  struct thread *parent = t->parent_thread;
+  struct intr_frame child_if;
+  bool success = false;
+
+  /* We may run before thread_create() returns our id to the
+     parent, so fill it in for process_wait() and exit. */
+  c->pid = t->tid;
+
+  memcpy (&child_if, args->if_, sizeof child_if);
+  child_if.eax = 0;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+  if (!page_table_init ())
+    goto done;
+
+  /* Pages of the executable are read through the child's own
+     handle, so they outlive the parent. */
+  t->exec_file = file_reopen (parent->exec_file);
+  if (t->exec_file == NULL)
+    goto done;
+  file_deny_write (t->exec_file);
+  t->rss_limit = parent->rss_limit;
+
+  success = (page_table_copy (parent, t->exec_file)
+             && fd_table_copy (&t->files, &parent->files));
+
+ done:
+  /* ARGS lives on the parent's stack, so this is the last use of
+     it: the parent returns as soon as we report. */
+  c->load_status = success ? LOAD_SUCCESS : LOAD_FAILED;
+  sema_up (&c->loading);
+  if (!success)
+    thread_exit ();
+
+  /* Start the child just as start_process() does. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&child_if) : "memory");
   NOT_REACHED ();
 }
 
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -164,12 +287,14 @@ process_wait (tid_t child_tid)
 
       //if child is done, we can return
       if(cp->load_status == LOAD_FAILED || cp->load_status == LOAD_SUCCESS){
+        int return_code = cp->return_code;
         if(cp->load_status == LOAD_FAILED) {
           list_remove(&cp->c_elem);
+          free(cp);
         }
         //printf("child return\n");
         //return 81;
-        return cp->return_code;
+        return return_code;
       }
 
       //check if we need to wait
@@ -196,23 +321,30 @@ void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  bool is_process = cur->pagedir != NULL;
   uint32_t *pd;
 
-//need to make sure that all files are removed before we close a process
-//Need to play around with the FOR loop:
-/*
-1) get first file_info
-2) get the file
-3) move onto next file_info
-4) deallocate file from number 2.s
-*/
-//list.h
-// for (e = list_begin (&foo_list); e != list_end (&foo_list);
-//      e = list_next (e))
-//   {
-//     struct foo *f = list_entry (e, struct foo, elem);
-//     ...do something with f...
-//   }
+  /* Close the files the process left open. */
+  fd_table_destroy (&cur->files);
+
+  /* With -pf, report the process's page faults. */
+  if (exception_fault_report && cur->pagedir != NULL)
+    exception_print_faults (cur);
+
+#ifdef VM
+  /* With -ws, report how much memory the process was using. */
+  if (frame_ws_report && cur->pagedir != NULL)
+    printf ("%s: rss %zu pages (peak %zu), working set %zu pages\n",
+            cur->name, cur->rss, cur->rss_peak, cur->wss);
+
+  /* Write back and remove file mappings, then forget the
+     process's pages and close the executable they were being
+     loaded from. */
+  mmap_unmap_all ();
+  page_table_destroy ();
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+#endif
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -232,6 +364,42 @@ process_exit (void)
     }
 
     printf ("%s: exit(%d)\n", cur->name, cur->exit_code);
+
+  release_children ();
+
+  /* With -mt, report kernel memory this process allocated and
+     never gave back.  Everything the process owns has been freed
+     by now, so whatever is left really leaked. */
+  if (memtrack_enabled && is_process)
+    memtrack_print_leaks (cur->tid);
+}
+
+/* Frees the current thread's records of its children.  Children
+   still running are orphaned, so that they do not look for their
+   records when they exit. */
+static void
+release_children (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  thread_foreach (orphan_child, cur);
+  intr_set_level (old_level);
+
+  while (!list_empty (&cur->children))
+    {
+      struct list_elem *e = list_pop_front (&cur->children);
+      free (list_entry (e, struct child_process, c_elem));
+    }
+}
+
+/* Orphans thread T if it is a child of PARENT. */
+static void
+orphan_child (struct thread *t, void *parent)
+{
+  if (t->parent_thread == parent)
+    t->parent_thread = NULL;
 }
 
 /* Sets up the CPU for running user code in the current
@@ -242,8 +410,8 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables, if they are not already. */
+  pagedir_switch (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -341,6 +509,10 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL)
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init ())
+    goto done;
+#endif
 
   /* Open executable file. */
 
@@ -449,7 +621,22 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* Segments are read in lazily, so keep the executable open
+     until the process exits.  Its read-only pages may be shared
+     with other processes through the page cache, so it must not
+     change underneath them either. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+      t->rss_limit = frame_rss_limit;
+    }
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
 
 
     return success;
@@ -457,7 +644,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -516,8 +705,44 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, nothing is read here: each page is only
+   recorded in the supplemental page table, and is read in by the
+   page fault handler when the process first touches it.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
+#ifdef VM
+static bool
+load_segment (struct file *file, off_t ofs, uint8_t *upage,
+              uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+{
+  ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (ofs % PGSIZE == 0);
+
+  while (read_bytes > 0 || zero_bytes > 0)
+    {
+      /* Calculate how to fill this page.
+         We will read PAGE_READ_BYTES bytes from FILE
+         and zero the final PAGE_ZERO_BYTES bytes. */
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      /* Record where the page comes from. */
+      if (page_read_bytes > 0
+          ? !page_add_file (upage, file, ofs, page_read_bytes, writable)
+          : !page_add_zero (upage, writable))
+        return false;
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      upage += PGSIZE;
+      ofs += page_read_bytes;
+    }
+  return true;
+}
+#else
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable)
@@ -562,9 +787,21 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
     }
   return true;
 }
+#endif
 
 /* Create a minimal stack by mapping a zeroed page at the top of
    user virtual memory. */
+#ifdef VM
+static bool
+setup_stack (void **esp)
+{
+  /* The page is faulted in when the arguments are pushed. */
+  if (!page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+}
+#else
 static bool
 setup_stack (void **esp)
 {
@@ -602,6 +839,7 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
 
 
 //-------------------------------------------------------------------- OUR CODE
@@ -32,6 +32,10 @@
  * #include "threads/vaddr.h" : default, was already included
  * #include "threads/synch.h" : used to access semaphores and their functions
  * #include "lib/string.h"  : used to access string functions.
+ * #include "threads/memtrack.h" : used to report memory still held at exit.
+ * #include "vm/page.h" : supplemental page table, for loading executables lazily
+ * #include "vm/frame.h" : for RSS limits and reports
+ * #include "vm/mmap.h" : to remove file mappings at exit
 ***************************************************/
 #include "threads/thread.h"
 #include <debug.h>
@@ -54,6 +58,12 @@
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "lib/string.h"
+#include "threads/memtrack.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#endif
 
 /***************************************************
  * Struct section:
@@ -83,6 +93,19 @@ struct address {
 **************************************************/
 tid_t process_execute (const char *file_name);
 
+#ifdef VM
+/**************************************************
+ * @name process_fork
+ * @return tid_t : returns the thread id of the child, or TID_ERROR
+ * @param struct intr_frame *if_: the parent's interrupt frame from the system call
+ * @date N/A
+ * @details creates a child that is a copy of the current process. Memory is
+ *    shared copy-on-write and open files are reopened at the same position.
+ *    The child returns 0 from the system call.
+**************************************************/
+tid_t process_fork (struct intr_frame *if_);
+#endif
+
 /**************************************************
  * @name process_wait
  * @return int : returns the status of the child thread or -1 if there were any issues.
@@ -106,7 +129,9 @@ void process_exit (void);
  * @return void
  * @param void
  * @date N/A
- * @details activate a process - this was code already supplied
+ * @details activate a process - this was code already supplied.
+ *    The page directory is only reloaded when it changes; kernel threads
+ *    keep the one already loaded (see pagedir_switch).
 **************************************************/
 void process_activate (void);
 
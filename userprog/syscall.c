@@ -1,35 +1,552 @@
 #include "userprog/syscall.h"
 
-static void syscall_handler(struct intr_frame *);
-static struct file_info* get_file (int fd);
+
+/***************************************************
+ * Include section:
+ * #include <stdio.h> : standard library
+ * #include <syscall-nr.h> : for syscall header, containing the definitions for the calls
+ * #include <syscall-io.h> : for the I/O structures shared with user programs
+ * #include "threads/interrupt.h" : for interrupt function when system call
+ * #include "threads/thread.h" : to include the thread struct and other structs from here
+ * #include "threads/init.h" : initialise/start
+ * #include "threads/synch.h" : for locks, semaphores and their corresponding functions
+ * #include "filesys/off_t.h" : to use the definition for off_t
+ * #include "filesys/file.h" : to use the file functions
+ * #include "filesys/filesys.h" : to use the filesys functions
+ * #include "threads/malloc.h" : to allocate memory to structs
+ * #include "devices/input.h" :
+ * #include "devices/shutdown.h" : for shutdown_power_off
+ * #include "userprog/process.h" : for process_execute and process_wait
+ * #include "threads/vaddr.h" :
+ * #include "threads/memtrack.h" : for the kernel memory statistics
+ * #include "threads/palloc.h" : for kernel copies of user strings and buffers
+ * #include "userprog/uaccess.h" : to copy to and from user memory safely
+ * #include "userprog/gdt.h" : for the segment selectors SYSENTER loads
+ * #include "userprog/tss.h" : for the kernel stack SYSENTER switches to
+ * #include "threads/cpu.h" : to check for and set up SYSENTER
+ * #include "vm/page.h" : to lock user buffers in memory during file I/O
+ * #include "vm/mmap.h" : for memory-mapped files
+***************************************************/
+#include <stdio.h>
+#include <syscall-nr.h>
+#include <syscall-io.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "filesys/off_t.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "userprog/process.h"
+#include "threads/vaddr.h"
+#include "threads/memtrack.h"
+#include "threads/palloc.h"
+#include "userprog/uaccess.h"
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#include "threads/cpu.h"
+#ifdef VM
+#include "vm/page.h"
+#include "vm/mmap.h"
+#endif
+
+/***************************************************
+ * Defines section:
+ * #define ARG_CODE 0
+ * #define ARG_1 4
+ * These are for the stating the locations on the stack
+ *   of the system call number and of its first argument,
+ *   which the rest follow.
+ * #define SYSCALL_MAX_ARGS 4
+ * The most arguments a system call takes.
+***************************************************/
+#define ARG_CODE 0
+#define ARG_1 4
+#define SYSCALL_MAX_ARGS 4
+
+/**************************************************
+ * @name syscall_func
+ * @description : a system call handler in the dispatch table
+ * @param struct intr_frame *f: the user's registers.
+ * @param const uint32_t *args: kernel copies of the call's arguments.
+ * @return uint32_t : the call's return value, for eax.
+**************************************************/
+typedef uint32_t syscall_func (struct intr_frame *f, const uint32_t *args);
+
+/**************************************************
+ * @name struct syscall_entry
+ * @description : an entry in the dispatch table, indexed by system call number
+ * @attribute syscall_func *handler: unpacks the arguments and does the call
+ * @attribute int argc: the number of arguments, at most SYSCALL_MAX_ARGS
+ * @attribute const char *name: for the statistics
+**************************************************/
+struct syscall_entry {
+  syscall_func *handler;
+  int argc;
+  const char *name;
+};
+
+/**************************************************
+ * @name sysenter_entry
+ * @return void
+ * @param void
+ * @details the SYSENTER entry point in userprog/sysenter.S, which
+ *    syscall_init() puts in MSR_SYSENTER_EIP when the CPU supports it.
+ *    It saves the user's registers as int 0x30 would, calls
+ *    syscall_handler() and returns to the user with SYSEXIT.
+ * @note not to be called from C.
+**************************************************/
+void sysenter_entry (void);
+
+/**************************************************
+ * @name load_stack
+ * @return uint32_t: for the value stored inside stack
+ * @param struct intr_frame *f: to get the esp.
+ * @param int offset: to get particular value from the offset
+ * @date N/A
+ * @details gets particular value from the offset given on the stack
+ * @note exits the process with -1 if the value is not in user memory.
+**************************************************/
+static uint32_t load_stack(struct intr_frame *f, int offset);
+
+/**************************************************
+ * @name copy_in_string
+ * @return char * : a kernel copy of the string in a page from palloc_get_page,
+ *    or NULL if the string is longer than a page or memory is exhausted.
+ * @param const char *ustr: the user string to copy.
+ * @details copies a string argument into the kernel, so that the file system
+ *    and process loader never touch user memory.
+ * @note exits the process with -1 if the string is not in user memory.
+ *    The caller frees the page with palloc_free_page.
+**************************************************/
+static char *copy_in_string(const char *ustr);
+
+/**************************************************
+ * @name handle_halt
+ * @return void
+ * @param void
+ * @date 15/2/2017
+ * @details halts/shutdowns thus terminating Pintos.
+ * @note we only call shutdown_power_off() from /threads/init.h
+**************************************************/
+static void handle_halt(void);
+
+/**************************************************
+ * @name handle_getpid
+ * @return tid_t : the caller's process id, as returned by exec and fork.
+ * @param void
+ * @details does no other work, so it measures the cost of a system call.
+**************************************************/
+static tid_t handle_getpid(void);
+
+/**************************************************
+ * @name handle_exit
+ * @return void
+ * @param int exit_code: the exit_code for a thread
+ * @date 15/2/2017
+ * @details exits a thread
+ * @note accomodate closing if a child...
+**************************************************/
+static void handle_exit (int exit_code);
+
+/**************************************************
+ * @name handle_close
+ * @return void
+ * @param int fd: the file descriptor for a particular file
+ * @date 15/2/2017
+ * @details closes a file from a given file descriptor
+**************************************************/
+static void handle_close(int fd);
+
+/**************************************************
+ * @name handle_create
+ * @return bool : for success creating file or failure creating file
+ * @param const char *file_name: the file name for the new file to create
+ * @param unsigned initial_size: the initial_size of the new file to create
+ * @date 15/2/2017
+ * @details creates a file from the given filename and of initiail size given
+**************************************************/
+static bool handle_create (const char *file_name, unsigned initial_size);
+
+/**************************************************
+ * @name handle_remove
+ * @return bool : for success or failure when attempting to remove file
+ * @param const char *file_name: the file name of the file to remove
+ * @date 15/2/2017
+ * @details creates a file from the given filename and of initiail size given
+**************************************************/
+static bool handle_remove (const char *file_name);
+
+/**************************************************
+ * @name handle_open
+ * @return int : returns a non negative file descriptor. -1 if could not be opened.
+ * @param char *file_name: the file name of the file to open
+ * @date 22/2/2017
+ * @details attempts to open a file from a given filename, returns a file decriptor
+ *    if open was successful. Returns -1 if the file could not be opened.
+ * @note File descriptors 0 and 1 are reserved for STDIN_FILENO and STDOUT_FILENO
+ *    standard input and output.
+ *    The files are stored in a file descriptor table inside each thread, and a new file
+ *    gets the lowest free file descriptor, found through the table's bitmap.
+**************************************************/
+static int handle_open(char *file_name);
+
+/**************************************************
+ * @name handle_filesize
+ * @return int : returns the size, in bytes, the size of the file from the given
+ *    file descriptor.
+ * @param int fd: the file descriptor for the corresponding file.
+ * @date 22/2/2017
+**************************************************/
+static int handle_filesize (int fd);
+
+/**************************************************
+ * @name handle_read
+ * @return int : amount read
+ * @param int fd: the file descriptor for a particular file
+ * @param const void *buffer: the buffer contains the data to read.
+ * @param unsigned int length: the length of (or up to) the buffer to read
+ * @date 22/2/2017
+ * @details reads data to a file
+**************************************************/
+static int handle_read(int fd, void *buffer, unsigned size);
+
+/**************************************************
+ * @name handle_write
+ * @return int : return the amount of bytes actually written
+ * @param int fd: the file descriptor for a particular file
+ * @param const void *buffer: the buffer contains the data to write.
+ * @param unsigned int length: the length of (or up to) the buffer to write
+ * @date 22/2/2017
+ * @details writes data to a file
+ * @note we have edited the original code to support the extra write function
+ *    of Pintos
+**************************************************/
+static int handle_write(int fd, const void *buffer, unsigned int length);
+
+/**************************************************
+ * @name handle_pread
+ * @return int : the number of bytes read, or -1 if fd is not an open file
+ *    or offset is out of range.
+ * @param int fd: the file descriptor for a particular file
+ * @param void *buffer: the buffer to read into.
+ * @param unsigned size: the number of bytes to read
+ * @param unsigned offset: the position in the file to read from.
+ * @details reads from the given position without using or moving the
+ *    file's position, so readers sharing a file do not get in each other's way.
+**************************************************/
+static int handle_pread(int fd, void *buffer, unsigned size, unsigned offset);
+
+/**************************************************
+ * @name handle_pwrite
+ * @return int : the number of bytes written, or -1 if fd is not an open file
+ *    or offset is out of range.
+ * @param int fd: the file descriptor for a particular file
+ * @param const void *buffer: the buffer to write.
+ * @param unsigned size: the number of bytes to write
+ * @param unsigned offset: the position in the file to write at.
+ * @details writes at the given position without using or moving the
+ *    file's position.
+**************************************************/
+static int handle_pwrite(int fd, const void *buffer, unsigned size, unsigned offset);
+
+/**************************************************
+ * @name handle_readv
+ * @return int : the total number of bytes read, or -1 if iovcnt is out of range.
+ * @param int fd: the file descriptor for a particular file
+ * @param const struct iovec *iov: the buffers to fill, in order.
+ * @param int iovcnt: the number of buffers, at most IOV_MAX.
+ * @details reads into several buffers with a single system call, as if by
+ *    one handle_read per buffer.
+**************************************************/
+static int handle_readv(int fd, const struct iovec *iov, int iovcnt);
+
+/**************************************************
+ * @name handle_writev
+ * @return int : the total number of bytes written, or -1 if iovcnt is out of range.
+ * @param int fd: the file descriptor for a particular file
+ * @param const struct iovec *iov: the buffers to write, in order.
+ * @param int iovcnt: the number of buffers, at most IOV_MAX.
+ * @details writes several buffers, e.g. a header and a payload, with a single
+ *    system call, as if by one handle_write per buffer.
+**************************************************/
+static int handle_writev(int fd, const struct iovec *iov, int iovcnt);
+
+/**************************************************
+ * @name xfer_vector
+ * @return int : the total number of bytes transferred, or -1 if iovcnt is
+ *    out of range.
+ * @param int fd: the file descriptor for a particular file
+ * @param const struct iovec *iov: the user's array of buffers.
+ * @param int iovcnt: the number of buffers.
+ * @param bool reading: true for handle_readv, false for handle_writev.
+ * @details copies in one buffer description at a time and transfers it,
+ *    stopping early at a short transfer, e.g. at the end of the file.
+**************************************************/
+static int xfer_vector(int fd, const struct iovec *iov, int iovcnt, bool reading);
+
+/**************************************************
+ * @name handle_ring_enter
+ * @return int : the number of operations carried out, or -1 if the ring's
+ *    number of entries is not a power of 2.
+ * @param struct ring *uring: the process's rings.
+ * @details carries out every queued submission, in order, posting a
+ *    completion for each, until the submission ring is empty or the
+ *    completion ring is full. A process doing many small I/Os thus
+ *    traps into the kernel once per batch instead of once per operation.
+ * @note the ring is only read and written with copy_from_user/copy_to_user,
+ *    and the process is killed if any part of it is not valid user memory.
+**************************************************/
+static int handle_ring_enter(struct ring *uring);
+
+/**************************************************
+ * @name ring_execute
+ * @return int : the result for the completion.
+ * @param const struct ring_sqe *sqe: a kernel copy of the submission.
+ * @details carries out one queued operation with the same handler as the
+ *    corresponding system call.
+ * @note a bad fd fails the operation with -1 instead of killing the process.
+**************************************************/
+static int ring_execute(const struct ring_sqe *sqe);
+
+/**************************************************
+ * @name file_xfer
+ * @return int : the number of bytes read or written.
+ * @param struct file *file: the file to read from or write to.
+ * @param uint8_t *buffer: the user buffer.
+ * @param unsigned size: the number of bytes to transfer.
+ * @param bool reading: true to read from the file into the buffer,
+ *    false to write the buffer to the file.
+ * @param off_t *ofs: the position to transfer at, advanced by the bytes
+ *    transferred, or NULL to use and advance the file's own position.
+ * @details transfers between a file and a user buffer, using
+ *    file_xfer_pinned or file_xfer_bounce.
+ * @note exits the process with -1 if the buffer is not valid user memory.
+**************************************************/
+static int file_xfer(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs);
+
+/**************************************************
+ * @name file_xfer_chunk
+ * @return off_t : the number of bytes read or written.
+ * @param struct file *file: the file to read from or write to.
+ * @param void *buffer: a buffer the file system may access without faulting.
+ * @param off_t size: the number of bytes to transfer.
+ * @param bool reading: true to read, false to write.
+ * @param off_t *ofs: as for file_xfer.
+ * @details calls file_read/file_write, or file_read_at/file_write_at if ofs
+ *    is not NULL.
+**************************************************/
+static off_t file_xfer_chunk(struct file *file, void *buffer, off_t size, bool reading, off_t *ofs);
+
+/**************************************************
+ * @name handle_seek
+ * @return void
+ * @param int fd: the file descriptor for a particular file
+ * @param unsigned position: the position, in bytes, to start reading from.
+ * @date 22/2/2017
+ * @details changes the next byte to read (or write to) in an open file (from
+ *    the corresponding file descriptor) from the position (in bytes) given.
+ * @note starting position of the file is 0.
+**************************************************/
+static void handle_seek(int fd, unsigned position);
+
+/**************************************************
+ * @name handle_tell
+ * @return off_t : returns the position, in bytes, of the next byte to read or to
+ *    be written to.
+ * @param int fd: the file desc********riptor for a particular file
+ * @date 22/2/2017
+ * @details returns the position of the next byte to be read/written in an open file
+ *    from the corresponding file descriptor given.
+ * @note starting position of the file is 0.
+**************************************************/
+static off_t handle_tell(int fd);
+
+/**************************************************
+ * @name handle_exec
+ * @return tid_t : returns the new process id. Must return -1 if the program cannot
+ *    be loaded or ran for any reason.
+ * @param const char *file_name: the file name for the new process to run.
+ *    E.g. "echo x y"
+ * @date 1/3/2017
+ * @details This returns the process ID for the new process. It will return -1
+ *    if the program cannot be loaded or ran. A parent process cannot return from
+ *    handle_exec until it knows if a child process is successfully loaded and can be ran.
+ * @note All the code for handle_exec is not contained in /userprog/syscall.c, but
+ *    instead contained in /userprog/process.c (particularly in the process_execute and start_process function).
+**************************************************/
+static tid_t handle_exec(const char *file_name);
+
+/**************************************************
+ * @name handle_wait
+ * @return int : returns the child's status if the child successfully is ended.
+ *    Returns -1 if there is an error (described more below).
+ * @param int child_tid: is the childs process ID to be used to indicate what child
+ *    the parent thread is waiting fget_fileor.
+ * @date 10/3/2017
+ * @details This returns the child thread's status if successfully waited, but also
+ *    returns -1 if there is an error.
+ *    These errors can occur by:
+ *    - child_tid does not refer to a direct child of the calling process. (bad_pid test)
+ *    - a child_tid that is alread waited, cannot be on wait twice.
+ * @note all the code for handle_wait is not contained in /userprog/syscall.c, but
+ *    instead contained in /userprog/process.c (particularly in the process_wait function)
+**************************************************/
+static int handle_wait(int child_tid);
+
+/**************************************************
+ * @name get_file
+ * @return struct file* : returns the open file of the file descriptor given.
+ * @param int fd: the file descriptor of file we looking for.
+ * @date 22/3/2017
+ * @details This returns the corresponding file from the file descriptor table
+ *    (inside the thread). It will return NULL if a file could not be found.
+ * @note This was added later in the code to allow our code to be more clean and understandable.
+ *    The table is an array indexed by fd, so the lookup takes constant time.
+**************************************************/
+static struct file* get_file (int fd);
+
+/**************************************************
+ * @name handle_memstat
+ * @return bool : true if kernel memory tracking is enabled, false otherwise.
+ * @param void
+ * @details prints the live kernel memory per allocation call site, as
+ *    recorded when the kernel is booted with the -mt option.
+ * @note the same report is printed at shutdown.
+**************************************************/
+static bool handle_memstat (void);
+
+#ifndef VM
+/**************************************************
+ * @name file_xfer_bounce
+ * @return int : the number of bytes read or written, or -1 if the buffer
+ *    is not valid user memory.
+ * @param struct file *file: the file to read from or write to.
+ * @param uint8_t *buffer: the user buffer.
+ * @param unsigned size: the number of bytes to transfer.
+ * @param bool reading: true to read from the file into the buffer,
+ *    false to write the buffer to the file.
+ * @param off_t *ofs: as for file_xfer.
+ * @details transfers the data a page at a time through a kernel buffer,
+ *    copied to or from the user buffer with copy_to_user/copy_from_user.
+**************************************************/
+static int file_xfer_bounce(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs);
+#endif
+
+#ifdef VM
+/**************************************************
+ * @name file_xfer_pinned
+ * @return int : the number of bytes read or written, or -1 if the buffer
+ *    is not valid user memory.
+ * @param struct file *file: the file to read from or write to.
+ * @param uint8_t *buffer: the user buffer.
+ * @param unsigned size: the number of bytes to transfer.
+ * @param bool reading: true to read from the file into the buffer,
+ *    false to write the buffer to the file.
+ * @param off_t *ofs: as for file_xfer.
+ * @details reads or writes the buffer one page at a time, locking each
+ *    page of the buffer in memory while the file system uses it.
+ * @note the file system must not page fault on the buffer: the fault could
+ *    need the same disk, or evict the very frame being read into.
+**************************************************/
+static int file_xfer_pinned(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs);
+
+/**************************************************
+ * @name handle_mmap
+ * @return mapid_t : the identifier of the new mapping, or MAP_FAILED.
+ * @param int fd: the file descriptor of the file to map.
+ * @param void *addr: the page-aligned address to map the file at.
+ * @details maps the whole file into consecutive pages starting at addr.
+ *    Pages are read in when first touched, and modified pages are written
+ *    back to the file when evicted, unmapped, or at exit.
+ * @note fails if the file is empty, addr is 0 or not page-aligned, or any
+ *    page of the range is already in use. Closing fd does not unmap the file.
+**************************************************/
+static mapid_t handle_mmap(int fd, void *addr);
+
+/**************************************************
+ * @name handle_munmap
+ * @return void
+ * @param mapid_t mapping: a mapping returned by handle_mmap.
+ * @details unmaps the mapping, writing back the pages that were modified.
+**************************************************/
+static void handle_munmap(mapid_t mapping);
+
+/**************************************************
+ * @name handle_fork
+ * @return tid_t : the child's pid in the parent, 0 in the child, or -1.
+ * @param struct intr_frame *f: the caller's interrupt frame, copied for the child.
+ * @details duplicates the calling process. The child shares the parent's memory
+ *    copy-on-write and gets its own handles for the parent's open files.
+ * @note file mappings are not inherited.
+**************************************************/
+static tid_t handle_fork(struct intr_frame *f);
+
+/**************************************************
+ * @name handle_madvise
+ * @return int : 0 if successful, -1 otherwise.
+ * @param void *addr: the page-aligned start of the range.
+ * @param unsigned length: the length of the range in bytes.
+ * @param int advice: one of the MADV_* values in lib/user/syscall.h.
+ * @details tells the VM how the range will be used: sequential or random
+ *    access steers readahead, WILLNEED and DONTNEED prefetch or evict the
+ *    pages now, and LOCK keeps them in memory until UNLOCK.
+ * @note every page of the range must already be part of the address space.
+**************************************************/
+static int handle_madvise(void *addr, unsigned length, int advice);
+#endif
 
 void syscall_init(void) {
     intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
+
+    //SYSENTER takes SS from the selector after CS, and SYSEXIT the user
+    //selectors after that, which is how the GDT is laid out. lib/user uses
+    //SYSENTER whenever CPUID reports it, so it must always be set up then.
+    if(cpu_has(CPUID_SEP)) {
+      wrmsr(MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr(MSR_SYSENTER_ESP, (uint32_t) tss_get_esp0());
+      wrmsr(MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    }
 }
 
 static void handle_close(int fd) {
-  struct file_info *fi;
-  fi = get_file(fd);
-  if(fi != NULL) {
-    file_close(fi->fp);
-    list_remove(&fi->fpelem);
-    free(fi);
+  struct file *file = fd_table_remove(&thread_current()->files, fd);
+  if(file != NULL) {
+    file_close(file);
   }
 }
 
 static uint32_t load_stack(struct intr_frame *f, int offset) {
+    uint32_t value;
 
-    // need to add check for valid address
-    // i.e. user can do bad things
-
-    // if (f->esp < PHYS_BASE){
-    //   printf("VALID\n");
-    // } else {
-    //   printf("INVALID\n");
-    // }
+    //esp comes from the user, so it may point anywhere
+    if(!copy_from_user(&value, f->esp + offset, sizeof value)) {
+      handle_exit(-1);
+    }
+    return value;
+}
 
-    return *((uint32_t*)(f->esp + offset));
+static char *copy_in_string(const char *ustr) {
+  char *kstr = palloc_get_page(0);
+  int length;
 
+  if(kstr == NULL) {
+    return NULL;
+  }
+  length = strncpy_from_user(kstr, ustr, PGSIZE);
+  if(length < 0) {
+    palloc_free_page(kstr);
+    handle_exit(-1);
+  }
+  //Too long to be any use
+  if(length == PGSIZE) {
+    palloc_free_page(kstr);
+    return NULL;
+  }
+  return kstr;
 }
 
 static int handle_write(int fd, const void *buffer, unsigned int length) {
@@ -37,16 +554,30 @@ static int handle_write(int fd, const void *buffer, unsigned int length) {
 
     //Fd 1 writes to the console
     if(fd == 1) {
-      //at least as long as size is not bigger than a few hundred bytes
-      //(It is reasonable to break up larger buffers.)
-      //if(sizeof (buffer) < 1000)
-      putbuf((const char *)buffer, (size_t) length);
+      //putbuf must not fault on the buffer, so it gets a copy,
+      //a page at a time (It is reasonable to break up larger buffers.)
+      char *kbuf = palloc_get_page(0);
+      unsigned done = 0;
+
+      if(kbuf == NULL) {
+        return 0;
+      }
+      while(done < length) {
+        unsigned chunk = length - done < PGSIZE ? length - done : PGSIZE;
+        if(!copy_from_user(kbuf, (const uint8_t *) buffer + done, chunk)) {
+          palloc_free_page(kbuf);
+          handle_exit(-1);
+        }
+        putbuf(kbuf, chunk);
+        done += chunk;
+      }
+      palloc_free_page(kbuf);
       return length;
     }
     else {
-      struct file_info *fi = get_file(fd);
-      if(fi != NULL) {
-        return file_write (fi->fp, buffer, length); //Returns the number of bytes actually written,
+      struct file *file = get_file(fd);
+      if(file != NULL) {
+        return file_xfer(file, (uint8_t *) buffer, length, false, NULL); //Returns the number of bytes actually written,
       }
       else {
         return 0;
@@ -89,13 +620,16 @@ static void handle_exit (int exit_code){
 //static int i = 3;
 static int handle_read(int fd, void *buffer, unsigned size) {
 
-  struct file_info *fi;
+  struct file *file;
 
     //Read the file (Standard In)
     if(fd == STDIN_FILENO) {
         int i;
         for(i = 0; i < (int)size; i++) {
-          *(uint8_t *)(buffer+i) = input_getc();
+          uint8_t c = input_getc();
+          if(!copy_to_user((uint8_t *) buffer + i, &c, 1)) {
+            handle_exit(-1);
+          }
         }
         return size;
     }
@@ -104,205 +638,533 @@ static int handle_read(int fd, void *buffer, unsigned size) {
       handle_exit(-1);
     }
     //Check if the file is NULL
-    fi = get_file(fd);
-    if (fi == NULL){
+    file = get_file(fd);
+    if (file == NULL){
       handle_exit(-1);
     }
     //Read each bytes from file
-    int bytes_read_fr = file_read(fi->fp, buffer, size);
-    return bytes_read_fr;
+    return file_xfer(file, buffer, size, true, NULL);
+}
+
+static int handle_pread(int fd, void *buffer, unsigned size, unsigned offset) {
+  struct file *file = get_file(fd);
+  off_t ofs = offset;
+
+  //The console has no positions to read at
+  if(file == NULL || ofs < 0) {
+    return -1;
+  }
+  return file_xfer(file, buffer, size, true, &ofs);
+}
+
+static int handle_pwrite(int fd, const void *buffer, unsigned size, unsigned offset) {
+  struct file *file = get_file(fd);
+  off_t ofs = offset;
+
+  if(file == NULL || ofs < 0) {
+    return -1;
+  }
+  return file_xfer(file, (uint8_t *) buffer, size, false, &ofs);
+}
+
+static int handle_readv(int fd, const struct iovec *iov, int iovcnt) {
+  return xfer_vector(fd, iov, iovcnt, true);
+}
+
+static int handle_writev(int fd, const struct iovec *iov, int iovcnt) {
+  return xfer_vector(fd, iov, iovcnt, false);
+}
+
+static int xfer_vector(int fd, const struct iovec *iov, int iovcnt, bool reading) {
+  int total = 0;
+  int i;
+
+  if(iovcnt < 0 || iovcnt > IOV_MAX) {
+    return -1;
+  }
+  for(i = 0; i < iovcnt; i++) {
+    struct iovec v;
+    int n;
+
+    //The vector itself is in user memory too
+    if(!copy_from_user(&v, iov + i, sizeof v)) {
+      handle_exit(-1);
+    }
+    n = reading ? handle_read(fd, v.iov_base, v.iov_len) : handle_write(fd, v.iov_base, v.iov_len);
+    if(n < 0) {
+      return total > 0 ? total : n;
+    }
+    total += n;
+    //Stop at the end of the file
+    if((unsigned) n != v.iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+static int handle_ring_enter(struct ring *uring) {
+  struct ring ring;
+  unsigned mask;
+  int done = 0;
+
+  //The ring lives in user memory, so the kernel works on a copy of its
+  //counters and writes back the ones it owns at the end
+  if(!copy_from_user(&ring, uring, sizeof ring)) {
+    handle_exit(-1);
+  }
+  if(ring.entries == 0 || (ring.entries & (ring.entries - 1)) != 0) {
+    return -1;
+  }
+  mask = ring.entries - 1;
+
+  while(ring.sq_head != ring.sq_tail && ring.cq_tail - ring.cq_head < ring.entries) {
+    struct ring_sqe sqe;
+    struct ring_cqe cqe;
+
+    if(!copy_from_user(&sqe, ring.sq + (ring.sq_head & mask), sizeof sqe)) {
+      handle_exit(-1);
+    }
+    cqe.user_data = sqe.user_data;
+    cqe.result = ring_execute(&sqe);
+    if(!copy_to_user(ring.cq + (ring.cq_tail & mask), &cqe, sizeof cqe)) {
+      handle_exit(-1);
+    }
+    ring.sq_head++;
+    ring.cq_tail++;
+    done++;
+  }
+
+  if(!copy_to_user(&uring->sq_head, &ring.sq_head, sizeof ring.sq_head)
+     || !copy_to_user(&uring->cq_tail, &ring.cq_tail, sizeof ring.cq_tail)) {
+    handle_exit(-1);
+  }
+  return done;
+}
+
+static int ring_execute(const struct ring_sqe *sqe) {
+  switch(sqe->op) {
+    case RING_OP_NOP:
+      return 0;
+    case RING_OP_READ:
+      //Unlike read, a bad fd only fails the operation
+      if(sqe->fd != STDIN_FILENO && get_file(sqe->fd) == NULL) {
+        return -1;
+      }
+      return handle_read(sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_WRITE:
+      if(sqe->fd != STDOUT_FILENO && get_file(sqe->fd) == NULL) {
+        return -1;
+      }
+      return handle_write(sqe->fd, sqe->buf, sqe->len);
+    case RING_OP_PREAD:
+      return handle_pread(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    case RING_OP_PWRITE:
+      return handle_pwrite(sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    case RING_OP_OPEN:
+      return handle_open(sqe->buf);
+    case RING_OP_CLOSE:
+      if(get_file(sqe->fd) == NULL) {
+        return -1;
+      }
+      handle_close(sqe->fd);
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+static int file_xfer(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs) {
+#ifdef VM
+  int total = file_xfer_pinned(file, buffer, size, reading, ofs);
+#else
+  int total = file_xfer_bounce(file, buffer, size, reading, ofs);
+#endif
+  if(total < 0) {
+    handle_exit(-1);
+  }
+  return total;
+}
+
+static off_t file_xfer_chunk(struct file *file, void *buffer, off_t size, bool reading, off_t *ofs) {
+  off_t n;
+
+  if(ofs == NULL) {
+    return reading ? file_read(file, buffer, size) : file_write(file, buffer, size);
+  }
+  n = reading ? file_read_at(file, buffer, size, *ofs) : file_write_at(file, buffer, size, *ofs);
+  *ofs += n;
+  return n;
+}
+
+#ifdef VM
+static int file_xfer_pinned(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs) {
+  int total = 0;
+
+  while(size > 0) {
+    //Stop at the end of the page
+    unsigned chunk = PGSIZE - pg_ofs(buffer);
+    off_t n;
+
+    if(chunk > size) {
+      chunk = size;
+    }
+    if(!page_lock(buffer, reading)) {
+      return -1;
+    }
+    n = file_xfer_chunk(file, buffer, chunk, reading, ofs);
+    page_unlock(buffer);
+
+    total += n;
+    if(n != (off_t) chunk) {
+      break;
+    }
+    buffer += chunk;
+    size -= chunk;
+  }
+  return total;
+}
+#else
+static int file_xfer_bounce(struct file *file, uint8_t *buffer, unsigned size, bool reading, off_t *ofs) {
+  uint8_t *kbuf = palloc_get_page(0);
+  int total = 0;
+
+  if(kbuf == NULL) {
+    return 0;
+  }
+  while(size > 0) {
+    unsigned chunk = size < PGSIZE ? size : PGSIZE;
+    off_t n;
+
+    if(!reading && !copy_from_user(kbuf, buffer, chunk)) {
+      total = -1;
+      break;
+    }
+    n = file_xfer_chunk(file, kbuf, chunk, reading, ofs);
+    if(reading && !copy_to_user(buffer, kbuf, n)) {
+      total = -1;
+      break;
+    }
+
+    total += n;
+    if(n != (off_t) chunk) {
+      break;
+    }
+    buffer += chunk;
+    size -= chunk;
+  }
+  palloc_free_page(kbuf);
+  return total;
 }
+#endif
 
 static void handle_seek(int fd, unsigned position) {
   /*
   we have a file descriptor and position
-  - So we will need to get the corresponding file (from our file info struct)
+  - So we will need to get the corresponding file (from our file descriptor table)
   - Pass the file into filesys/file.h function
     - void file_seek (struct file *, off_t);
   */
   //consider a check later
-  struct file_info *fi = get_file(fd);
-  if(fi != NULL) {
-    file_seek(fi->fp, position);
+  struct file *file = get_file(fd);
+  if(file != NULL) {
+    file_seek(file, position);
   }
 }
 
 static off_t handle_tell(int fd) {
   /*
   we have a file descriptor
-  - So we will need to get the corresponding file (from our file info struct)
+  - So we will need to get the corresponding file (from our file descriptor table)
   - Pass the file into filesys/file.h function
     - off_t file_tell (struct file *);
   */
-  struct file_info *fi = get_file(fd);
-  if(fi != NULL) {
-    return file_tell (fi->fp);
+  struct file *file = get_file(fd);
+  if(file != NULL) {
+    return file_tell (file);
   }
   else {
     return 0;
   }
 }
 
-static struct file_info* get_file (int fd){
-
-  struct thread *cur = thread_current ();
-  struct list_elem *e;
-  struct file_info *fi;
-
-  for(e = list_begin(&cur->files); e != list_end(&cur->files); e = list_next(e)){
-    fi = list_entry(e, struct file_info, fpelem);
-
-    if(fi->fd == fd) {
-      return fi;
-    }
-  }
-
-  return NULL;
+static struct file* get_file (int fd){
+  return fd_table_get(&thread_current()->files, fd);
 }
 
 static bool handle_create (const char *file_name, unsigned initial_size) {
-  return filesys_create(file_name, initial_size);
+  char *name = copy_in_string(file_name);
+  bool success = name != NULL && filesys_create(name, initial_size);
+  palloc_free_page(name);
+  return success;
 }
 
 static bool handle_remove (const char *file_name) {
-  return filesys_remove(file_name);
+  char *name = copy_in_string(file_name);
+  bool success = name != NULL && filesys_remove(name);
+  palloc_free_page(name);
+  return success;
 }
 
 static int handle_open(char* file_name) {
 
-  struct file* file = filesys_open(file_name);
+  char *name = copy_in_string(file_name);
+  struct file* file = name != NULL ? filesys_open(name) : NULL;
   struct thread *cur = thread_current ();
   int fd;
 
+  palloc_free_page(name);
   if (file == NULL){
       fd = -1;
       return fd;
   }
 
-  struct file_info *fi = malloc(sizeof(struct file_info)); //allocate size for file to open.
-
-  fd = 2; //0 and 1 are reserved for STDIN_FILENO and STDOUT_FILENO
-  while(get_file(fd) != NULL) {
-    fd++;
+  //takes the lowest free fd (0 and 1 are reserved for STDIN_FILENO and STDOUT_FILENO)
+  fd = fd_table_add(&cur->files, file);
+  if(fd < 0) {
+    file_close(file);
   }
-  //store onto the threads list of files
-  fi->fd = fd;
-  fi->fp = file;
-  list_push_back(&cur->files, &fi->fpelem);
-
   return fd;
 }
 
 static int handle_filesize (int fd)
 {
-  struct file_info *fi = get_file (fd);
-  if( fi == NULL ) handle_exit(-1);
-  return file_length (fi->fp);
+  struct file *file = get_file (fd);
+  if( file == NULL ) handle_exit(-1);
+  return file_length (file);
 }
 
 static tid_t handle_exec (const char *file_name){
-  return process_execute ((char *)file_name);;
+  char *cmd_line = copy_in_string(file_name);
+  tid_t tid = cmd_line != NULL ? process_execute (cmd_line) : TID_ERROR;
+  palloc_free_page(cmd_line);
+  return tid;
 }
 
 static int handle_wait(int child_tid){
   return process_wait(child_tid);
 }
 
-static void handle_halt() {
+static tid_t handle_getpid(void) {
+  return thread_current()->tid;
+}
+
+static void handle_halt(void) {
   shutdown_power_off();
 }
 
-static void syscall_handler(struct intr_frame *f) {
-  int code = (int) load_stack(f, ARG_CODE);
-  switch (code) {
-    case SYS_HALT:{
-      // printf("Testing SYS_HALT\n");
-      handle_halt();
-      break;
-    }
-    case SYS_EXIT: {
-      // printf("Testing SYS_EXIT\n");
-      handle_exit(load_stack(f, ARG_1));
-      break;
-    }
-    case SYS_EXEC: {
-      // printf("Testing SYS_EXEC\n");
-      f->eax = handle_exec((const char *)load_stack(f, ARG_1));
-      break;
-    }
-    case SYS_WAIT: {
-      // printf("Testing SYS_WAIT\n");
-      f->eax = handle_wait((int) load_stack(f, ARG_1));
-      break;
-    }
-    case SYS_CREATE: {
-      // printf("Testing SYS_CREATE\n");
-      bool result = handle_create(
-              (const char *)load_stack(f, ARG_1),
-              (unsigned)load_stack(f, ARG_2));
-      f->eax = result;
-      break;
-    }
-    case SYS_REMOVE: {
-      // printf("REMOVE Incomplete\n");
-      bool result = handle_remove(
-              (const char *)load_stack(f, ARG_1));
-      f->eax = result;
-      break;
-    }
-    case SYS_OPEN: {
-      // printf("Testing SYS_OPEN\n");
-      char *fileName = (char *)load_stack(f, ARG_1);
-      f->eax = handle_open(fileName);
-      break;
-    }
-    case SYS_FILESIZE: {
-      // printf("Testing SYS_FILESIZE\n");
-      f->eax = handle_filesize((int) load_stack(f, ARG_1));
-      break;
-    }
-    case SYS_READ: {
-      // printf("Testing SYS_READ\n");
-      int result = handle_read(
-              (int) load_stack(f, ARG_1),
-              (void *) load_stack(f, ARG_2),
-              (unsigned) load_stack(f, ARG_3));
-      f->eax = result;
-      break;
-    }
-    case SYS_WRITE: {
-      //needs debugging
-      // printf("Testing SYS_WRITE\n");
-      int result = handle_write(
-              (int) load_stack(f, ARG_1),
-              (void *) load_stack(f, ARG_2),
-              (unsigned int) load_stack(f, ARG_3)); // set return value
-      f->eax = result;
-      break;
-    }
-    case SYS_SEEK: {
-      //printf("Testing SYS_SEEK\n");
-      handle_seek(
-              (int) load_stack(f, ARG_1),
-              (unsigned) load_stack(f, ARG_2));
-      break;
-    }
-    case SYS_TELL: {
-      //printf("Testing SYS_TELL\n");
-      unsigned result = handle_tell(
-              (int) load_stack(f, ARG_1)
-      );
-      f->eax = result;
-      break;
-    }
-    case SYS_CLOSE: {
-      // printf("Testing SYS_CLOSE\n");
-      //printf("CLOSE\n"); //Debugging
-      handle_close((int)load_stack(f, ARG_1));
-      break;
-    }
-    default:
-      printf("SYS_CALL (%d) not recognised\n", code);
-      thread_exit();
+static bool handle_memstat (void) {
+  memtrack_print_stats ();
+  return memtrack_enabled;
+}
+
+#ifdef VM
+static mapid_t handle_mmap(int fd, void *addr) {
+  struct file *file = get_file(fd);
+  //Console file descriptors and closed files cannot be mapped
+  if(file == NULL) {
+    return MAP_FAILED;
+  }
+  return mmap_map(file, addr);
+}
+
+static void handle_munmap(mapid_t mapping) {
+  mmap_unmap(mapping);
+}
+
+static tid_t handle_fork(struct intr_frame *f) {
+  return process_fork(f);
+}
+
+static int handle_madvise(void *addr, unsigned length, int advice) {
+  return page_advise(addr, length, (enum page_advice) advice) ? 0 : -1;
+}
+#endif
+
+static uint32_t sys_halt(struct intr_frame *f UNUSED, const uint32_t *args UNUSED) {
+  handle_halt();
+  NOT_REACHED();
+}
+
+static uint32_t sys_exit(struct intr_frame *f UNUSED, const uint32_t *args) {
+  handle_exit((int) args[0]);
+  NOT_REACHED();
+}
+
+static uint32_t sys_exec(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_exec((const char *) args[0]);
+}
+
+static uint32_t sys_wait(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_wait((int) args[0]);
+}
+
+static uint32_t sys_create(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_create((const char *) args[0], (unsigned) args[1]);
+}
+
+static uint32_t sys_remove(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_remove((const char *) args[0]);
+}
+
+static uint32_t sys_open(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_open((char *) args[0]);
+}
+
+static uint32_t sys_filesize(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_filesize((int) args[0]);
+}
+
+static uint32_t sys_read(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_read((int) args[0], (void *) args[1], (unsigned) args[2]);
+}
+
+static uint32_t sys_write(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_write((int) args[0], (const void *) args[1], (unsigned) args[2]);
+}
+
+static uint32_t sys_seek(struct intr_frame *f UNUSED, const uint32_t *args) {
+  handle_seek((int) args[0], (unsigned) args[1]);
+  return 0;
+}
+
+static uint32_t sys_tell(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_tell((int) args[0]);
+}
+
+static uint32_t sys_close(struct intr_frame *f UNUSED, const uint32_t *args) {
+  handle_close((int) args[0]);
+  return 0;
+}
+
+static uint32_t sys_memstat(struct intr_frame *f UNUSED, const uint32_t *args UNUSED) {
+  return handle_memstat();
+}
+
+static uint32_t sys_readv(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_readv((int) args[0], (const struct iovec *) args[1], (int) args[2]);
+}
+
+static uint32_t sys_writev(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_writev((int) args[0], (const struct iovec *) args[1], (int) args[2]);
+}
+
+static uint32_t sys_pread(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_pread((int) args[0], (void *) args[1], (unsigned) args[2], (unsigned) args[3]);
+}
+
+static uint32_t sys_pwrite(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_pwrite((int) args[0], (const void *) args[1], (unsigned) args[2], (unsigned) args[3]);
+}
+
+static uint32_t sys_ring_enter(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_ring_enter((struct ring *) args[0]);
+}
+
+static uint32_t sys_getpid(struct intr_frame *f UNUSED, const uint32_t *args UNUSED) {
+  return handle_getpid();
+}
+
+#ifdef VM
+static uint32_t sys_mmap(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_mmap((int) args[0], (void *) args[1]);
+}
+
+static uint32_t sys_munmap(struct intr_frame *f UNUSED, const uint32_t *args) {
+  handle_munmap((mapid_t) args[0]);
+  return 0;
+}
+
+static uint32_t sys_fork(struct intr_frame *f, const uint32_t *args UNUSED) {
+  return handle_fork(f);
+}
+
+static uint32_t sys_madvise(struct intr_frame *f UNUSED, const uint32_t *args) {
+  return handle_madvise((void *) args[0], (unsigned) args[1], (int) args[2]);
+}
+#endif
+
+//Indexed by system call number; calls without a handler are not recognised
+static const struct syscall_entry syscall_table[] = {
+  [SYS_HALT] = {sys_halt, 0, "halt"},
+  [SYS_EXIT] = {sys_exit, 1, "exit"},
+  [SYS_EXEC] = {sys_exec, 1, "exec"},
+  [SYS_WAIT] = {sys_wait, 1, "wait"},
+  [SYS_CREATE] = {sys_create, 2, "create"},
+  [SYS_REMOVE] = {sys_remove, 1, "remove"},
+  [SYS_OPEN] = {sys_open, 1, "open"},
+  [SYS_FILESIZE] = {sys_filesize, 1, "filesize"},
+  [SYS_READ] = {sys_read, 3, "read"},
+  [SYS_WRITE] = {sys_write, 3, "write"},
+  [SYS_SEEK] = {sys_seek, 2, "seek"},
+  [SYS_TELL] = {sys_tell, 1, "tell"},
+  [SYS_CLOSE] = {sys_close, 1, "close"},
+#ifdef VM
+  [SYS_MMAP] = {sys_mmap, 2, "mmap"},
+  [SYS_MUNMAP] = {sys_munmap, 1, "munmap"},
+#endif
+  [SYS_MEMSTAT] = {sys_memstat, 0, "memstat"},
+#ifdef VM
+  [SYS_FORK] = {sys_fork, 0, "fork"},
+  [SYS_MADVISE] = {sys_madvise, 3, "madvise"},
+#endif
+  [SYS_READV] = {sys_readv, 3, "readv"},
+  [SYS_WRITEV] = {sys_writev, 3, "writev"},
+  [SYS_PREAD] = {sys_pread, 4, "pread"},
+  [SYS_PWRITE] = {sys_pwrite, 4, "pwrite"},
+  [SYS_RING_ENTER] = {sys_ring_enter, 1, "ring_enter"},
+  [SYS_GETPID] = {sys_getpid, 0, "getpid"},
+};
+
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
+//Calls made and CPU cycles spent in each system call, from entry to return
+static unsigned long long syscall_cnt[SYSCALL_CNT];
+static unsigned long long syscall_cycles[SYSCALL_CNT];
+
+void syscall_handler(struct intr_frame *f) {
+  const struct syscall_entry *call;
+  uint32_t args[SYSCALL_MAX_ARGS];
+  unsigned code;
+  uint64_t start;
+  enum intr_level old_level;
+
+#ifdef VM
+  //Page faults on user memory during the call need the user's esp
+  thread_current()->user_esp = f->esp;
+#endif
+  code = load_stack(f, ARG_CODE);
+  if(code >= SYSCALL_CNT || syscall_table[code].handler == NULL) {
+    printf("SYS_CALL (%d) not recognised\n", (int) code);
+    thread_exit();
+  }
+  call = &syscall_table[code];
+
+  //One copy fetches the arguments and checks that they are all in user memory
+  ASSERT(call->argc <= SYSCALL_MAX_ARGS);
+  if(!copy_from_user(args, f->esp + ARG_1, call->argc * sizeof *args)) {
+    handle_exit(-1);
+  }
+
+  old_level = intr_disable();
+  syscall_cnt[code]++;
+  intr_set_level(old_level);
+
+  start = rdtsc();
+  f->eax = call->handler(f, args);
+
+  old_level = intr_disable();
+  syscall_cycles[code] += rdtsc() - start;
+  intr_set_level(old_level);
+}
+
+void syscall_print_stats(void) {
+  size_t code;
+
+  for(code = 0; code < SYSCALL_CNT; code++) {
+    if(syscall_cnt[code] > 0) {
+      printf("Syscall: %llu %s calls, %llu cycles\n",
+             syscall_cnt[code], syscall_table[code].name, syscall_cycles[code]);
     }
+  }
 }
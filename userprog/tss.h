@@ -6,6 +6,7 @@
 struct tss;
 void tss_init (void);
 struct tss *tss_get (void);
+void **tss_get_esp0 (void);
 void tss_update (void);
 
 #endif /* userprog/tss.h */
@@ -0,0 +1,154 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <limits.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+
+   System calls receive pointers from user programs, which may
+   point anywhere.  Rather than checking each page of a buffer
+   in the page directory before touching it, the functions here
+   only check that the buffer lies below PHYS_BASE and then copy
+   it at full speed.  If an access faults and page_fault() cannot
+   bring the page in, because the address is not part of the
+   process's address space, page_fault() looks up the faulting
+   instruction in the exception table and resumes execution at
+   the fixup address recorded there instead of killing the
+   kernel.  The copy then stops and reports failure.
+
+   Each instruction that may fault on user memory gets an entry
+   in the exception table, which the linker gathers from the
+   __ex_table sections of all object files (see
+   threads/kernel.lds.S). */
+
+/* An entry in the exception table. */
+struct exception_entry
+  {
+    uintptr_t insn;             /* Address of instruction that may fault. */
+    uintptr_t fixup;            /* Where to continue if it does. */
+  };
+
+/* The exception table, from the linker script. */
+extern const struct exception_entry _start_ex_table[], _end_ex_table[];
+
+/* Returns true if the SIZE bytes starting at UADDR all lie in
+   user virtual memory. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (is_user_vaddr (uaddr)
+          && size <= (size_t) ((const uint8_t *) PHYS_BASE
+                               - (const uint8_t *) uaddr));
+}
+
+/* Copies SIZE bytes from SRC to DST, either of which may be in
+   user memory.  Returns the number of bytes left uncopied
+   because of a fault, 0 if successful. */
+static size_t
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  /* The CPU updates ECX, ESI and EDI after each byte moved by
+     REP MOVSB, so after a fault ECX tells how far it got. */
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                ".section __ex_table, \"a\"\n"
+                "  .long 1b, 2b\n"
+                ".previous"
+                : "+D" (dst), "+S" (src), "+c" (size)
+                :
+                : "memory");
+  return size;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the bytes is
+   not readable user memory, in which case DST may have been
+   partially written. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_bytes (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the bytes
+   is not writable user memory, in which case UDST may have been
+   partially written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_bytes (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC,
+   including the null terminator, into the SIZE bytes at DST.
+   Returns the length of the string, not counting the null
+   terminator, if it fits.  Returns SIZE, leaving DST
+   unterminated, if it does not.  Returns -1 if the string is not
+   readable user memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  char *end = dst;
+  size_t left, copied;
+  int faulted = 0;
+
+  ASSERT (size <= INT_MAX);
+
+  /* Don't let the string run on into kernel memory. */
+  if (!is_user_vaddr (usrc))
+    return -1;
+  left = (size_t) ((const char *) PHYS_BASE - usrc);
+  if (left > size)
+    left = size;
+
+  asm volatile ("0: testl %[left], %[left]\n"
+                "   jz 2f\n"
+                "1: lodsb\n"
+                "   stosb\n"
+                "   decl %[left]\n"
+                "   testb %%al, %%al\n"
+                "   jnz 0b\n"
+                "   jmp 2f\n"
+                "3: movl $1, %[faulted]\n"
+                "2:\n"
+                ".section __ex_table, \"a\"\n"
+                "  .long 1b, 3b\n"
+                ".previous"
+                : [left] "+r" (left), "+S" (usrc), "+D" (end),
+                  [faulted] "+r" (faulted)
+                :
+                : "eax", "cc", "memory");
+
+  copied = end - dst;
+  if (faulted)
+    return -1;
+  else if (copied > 0 && dst[copied - 1] == '\0')
+    return copied - 1;
+  else if (copied == size)
+    return size;
+  else
+    {
+      /* Reached PHYS_BASE without finding the terminator. */
+      return -1;
+    }
+}
+
+/* If the kernel faulted at F->eip on an instruction listed in the
+   exception table, makes F resume at the instruction's fixup
+   address and returns true.  Otherwise, returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct exception_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,739 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   At startup the frame table takes every page of the user pool
+   and from then on hands them out to process pages itself.  When
+   no frame is free, one is reclaimed from some process by the
+   "clock" (second chance) algorithm: frames are visited in a
+   circle, and a frame whose pages have been accessed since the
+   previous visit has their accessed bits cleared and is skipped
+   this time around.  The first frame whose pages have not been
+   accessed is evicted by page_out().  If it has to go to swap,
+   the clock keeps going to collect up to SWAP_CLUSTER - 1 more
+   such victims, and all of them are written out together; the
+   extra frames become free for the faults that follow.
+
+   A frame can be shared by pages of several processes, all
+   mapped read-only.  The frame stays in use until the last of
+   them lets go of it, and eviction unmaps all of them.
+
+   Read-only pages of executables are shared through the page
+   cache, which maps a file and offset to the frame that holds
+   that part of the file.  A process that faults on such a page
+   while another process has it in memory simply maps the same
+   frame.  A frame leaves the page cache when its last page lets
+   go of it or it is evicted.
+
+   Pages that are still all zeros and have only been read share
+   the zero frame, a single page of zeros that is mapped
+   read-only everywhere.  It is not part of the frame table, so
+   it is never evicted; the first write to such a page gives the
+   page a frame of its own (see vm/page.c).
+
+   Each frame has a lock.  Whoever holds it may change the
+   frame's pages and those pages' `frame' members, so holding
+   the lock also pins the frame in place: the clock never evicts
+   a frame whose lock it cannot obtain.  Nor does it evict a
+   frame that a process has locked into memory with MADV_LOCK,
+   so each process may lock only so many pages (see
+   frame_lock_limit()), leaving the clock frames to choose from.
+
+   Each process's resident set size (RSS), the number of its
+   pages that have a frame other than the zero frame, is kept up
+   to date as pages come and go.  A process may be limited to a
+   given RSS (see -rss): once it reaches the limit, it gets
+   frames by evicting its own pages, so it cannot push other
+   processes' pages out.
+
+   A background thread estimates each process's working set,
+   the number of its pages used in the last WS_INTERVAL, from
+   the pages' accessed bits.  It moves each bit it finds set
+   into the page (see page_sample_accessed()), where the clock
+   still sees it.
+
+   A 4 MB page takes HUGE_FRAMES free frames in a row whose
+   memory is contiguous and suitably aligned, which is only
+   possible because the frame table takes the user pool in
+   address order.  The frames remain individual frames: each
+   holds one page of the 4 MB page and is evicted on its own. */
+
+/* Interval between working set samples, in timer ticks. */
+#define WS_INTERVAL TIMER_FREQ
+
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* The zero frame. */
+static struct frame zero_frame;
+
+/* Protects the clock hand and the search for a frame. */
+static struct lock scan_lock;
+static size_t hand;
+
+/* Page cache: frames that hold read-only file data, by file
+   and offset.  Only frames in use are in the cache. */
+static struct hash cache;
+static struct lock cache_lock;
+
+/* -rss: RSS limit for new processes, in pages, or 0 for none. */
+size_t frame_rss_limit;
+
+/* -ws: Report RSS and working set of each process at exit? */
+bool frame_ws_report;
+
+/* Statistics. */
+static unsigned long long cache_hit_cnt, cache_miss_cnt;
+static unsigned long long rss_evict_cnt;
+
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+static struct frame *cache_get (struct inode *, off_t, size_t read_bytes,
+                                struct page *, bool wait);
+static void uncache (struct frame *);
+static void count_page (struct frame *, struct page *, int delta);
+static thread_func sampler NO_RETURN;
+
+/* Initializes the frame table, taking over the user pool. */
+void
+frame_init (void)
+{
+  void *base;
+
+  lock_init (&scan_lock);
+  lock_init (&cache_lock);
+  if (!hash_init (&cache, cache_hash, cache_less, NULL))
+    PANIC ("out of memory allocating page cache");
+
+  /* The zero frame comes from the kernel pool, so that it
+     does not take a frame from processes. */
+  lock_init (&zero_frame.lock);
+  zero_frame.base = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&zero_frame.pages);
+  zero_frame.ref_cnt = 0;
+  zero_frame.inode = NULL;
+
+  frames = malloc (sizeof *frames * init_ram_pages);
+  if (frames == NULL)
+    PANIC ("out of memory allocating page frames");
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL)
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+      f->ref_cnt = 0;
+      f->inode = NULL;
+    }
+}
+
+/* Tries to lock frame F without waiting.  Fails if F is locked,
+   including by the current thread, which may hold one frame
+   while it allocates another. */
+static bool
+try_lock (struct frame *f)
+{
+  return !lock_held_by_current_thread (&f->lock)
+         && lock_try_acquire (&f->lock);
+}
+
+/* Takes a free frame for PAGE and locks it.  Returns a null
+   pointer if no frame is free.  Must be called with scan_lock
+   held. */
+static struct frame *
+find_free_frame (struct page *page)
+{
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[i];
+      if (!try_lock (f))
+        continue;
+      if (f->ref_cnt == 0)
+        {
+          frame_attach (f, page);
+          return f;
+        }
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Returns true if any page in frame F has been accessed since
+   the last call, clearing their accessed bits.  F must be locked
+   by the current thread. */
+static bool
+accessed_recently (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_accessed_recently (list_entry (e, struct page, frame_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Returns true if evicting frame F would write it to swap.  F
+   must be locked by the current thread. */
+static bool
+needs_swap (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (page_needs_swap (list_entry (e, struct page, frame_elem)))
+      return true;
+  return false;
+}
+
+/* Returns true if a page in frame F has been locked into memory
+   with MADV_LOCK.  F must be locked by the current thread. */
+static bool
+pinned (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->locked)
+      return true;
+  return false;
+}
+
+/* Returns true if frame F, which must be locked by the current
+   thread, holds only a page of thread T. */
+static bool
+owned_by (struct frame *f, struct thread *t)
+{
+  return (f->ref_cnt == 1
+          && list_entry (list_front (&f->pages),
+                         struct page, frame_elem)->thread == t);
+}
+
+/* Returns the most pages that thread T may lock into memory
+   with MADV_LOCK: a quarter of the frames, or half of T's RSS
+   limit if it has a smaller one, so that T can still bring the
+   rest of its pages in. */
+size_t
+frame_lock_limit (const struct thread *t)
+{
+  size_t limit = frame_cnt / 4;
+
+  if (t->rss_limit > 0 && t->rss_limit / 2 < limit)
+    limit = t->rss_limit / 2;
+  return limit;
+}
+
+/* Returns true if thread T has reached its RSS limit. */
+static bool
+over_rss_limit (struct thread *t)
+{
+  return t->rss_limit > 0 && t->rss >= t->rss_limit;
+}
+
+/* Advances the clock hand to the next frame that can be evicted
+   and returns it locked.  If OWNER is nonnull, only frames that
+   hold only a page of OWNER qualify.  Clears the accessed bits
+   of the qualifying pages it passes over.  Gives up after
+   visiting MAX_VISITS frames and returns a null pointer.  Must
+   be called with scan_lock held. */
+static struct frame *
+next_victim (size_t max_visits, struct thread *owner)
+{
+  size_t i;
+
+  for (i = 0; i < max_visits; i++)
+    {
+      struct frame *f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+
+      if (!try_lock (f))
+        continue;
+      if (f->ref_cnt > 0 && (owner == NULL || owned_by (f, owner))
+          && !pinned (f) && !accessed_recently (f))
+        return f;
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Allocates a frame for PAGE, evicting some other page if
+   necessary, and returns it locked.  If PAGE's process is at its
+   RSS limit, one of its own pages is evicted instead, if it has
+   one that can be.  Returns a null pointer if no frame can be
+   obtained, e.g. because every frame is pinned or swap is
+   full. */
+struct frame *
+frame_alloc_and_lock (struct page *page)
+{
+  struct frame *victims[SWAP_CLUSTER];
+  struct thread *owner = NULL;
+  size_t victim_cnt;
+  struct frame *f;
+  size_t i;
+
+  ASSERT (frame_cnt > 0);
+
+  /* Two trips around the clock are enough to clear every
+     accessed bit. */
+  lock_acquire (&scan_lock);
+  if (over_rss_limit (page->thread))
+    {
+      owner = page->thread;
+      victims[0] = next_victim (frame_cnt * 2, owner);
+      if (victims[0] != NULL)
+        rss_evict_cnt++;
+      else
+        owner = NULL;
+    }
+  if (owner == NULL)
+    {
+      f = find_free_frame (page);
+      if (f != NULL)
+        {
+          lock_release (&scan_lock);
+          return f;
+        }
+
+      /* No free frame.  Find a frame to evict. */
+      victims[0] = next_victim (frame_cnt * 2, NULL);
+      if (victims[0] == NULL)
+        {
+          lock_release (&scan_lock);
+          return NULL;
+        }
+    }
+  victim_cnt = 1;
+
+  /* Batch up more frames bound for swap, but don't go far. */
+  if (needs_swap (victims[0]))
+    while (victim_cnt < SWAP_CLUSTER
+           && (f = next_victim (SWAP_CLUSTER, owner)) != NULL)
+      {
+        if (needs_swap (f))
+          victims[victim_cnt++] = f;
+        else
+          lock_release (&f->lock);
+      }
+  lock_release (&scan_lock);
+
+  /* Evict them.  Frames that could not be evicted keep their
+     pages. */
+  page_out (victims, victim_cnt);
+  for (i = 0; i < victim_cnt; i++)
+    if (victims[i]->ref_cnt == 0)
+      uncache (victims[i]);
+  for (i = 1; i < victim_cnt; i++)
+    frame_unlock (victims[i]);
+
+  f = victims[0];
+  if (f->ref_cnt > 0)
+    {
+      frame_unlock (f);
+      return NULL;
+    }
+  frame_attach (f, page);
+  return f;
+}
+
+/* Takes a free frame for PAGE and returns it locked, without
+   evicting anything.  Returns a null pointer if no frame is
+   free or PAGE's process is at its RSS limit. */
+struct frame *
+frame_try_alloc_and_lock (struct page *page)
+{
+  struct frame *f;
+
+  if (over_rss_limit (page->thread))
+    return NULL;
+
+  lock_acquire (&scan_lock);
+  f = find_free_frame (page);
+  lock_release (&scan_lock);
+  return f;
+}
+
+/* Finds HUGE_FRAMES free frames that hold 4 MB of physically
+   contiguous, 4 MB-aligned memory, for a large page of thread
+   T, and returns the first of them, with all of them locked and
+   without pages.  The rest follow it in order in the frame
+   table.  Nothing is evicted to make room.  Returns a null
+   pointer if there is no such run of frames or T would exceed
+   its RSS limit. */
+struct frame *
+frame_alloc_huge_and_lock (struct thread *t)
+{
+  size_t i, j;
+
+  if (t->rss_limit > 0 && t->rss + HUGE_FRAMES > t->rss_limit)
+    return NULL;
+
+  lock_acquire (&scan_lock);
+  for (i = 0; i + HUGE_FRAMES <= frame_cnt; i++)
+    {
+      uint8_t *base = frames[i].base;
+
+      if (vtop (base) % PTSPAN != 0)
+        continue;
+      for (j = 0; j < HUGE_FRAMES; j++)
+        {
+          struct frame *f = &frames[i + j];
+          if (f->base != base + j * PGSIZE || !try_lock (f))
+            break;
+          if (f->ref_cnt != 0)
+            {
+              lock_release (&f->lock);
+              break;
+            }
+        }
+      if (j == HUGE_FRAMES)
+        {
+          lock_release (&scan_lock);
+          return &frames[i];
+        }
+      while (j-- > 0)
+        lock_release (&frames[i + j].lock);
+    }
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Attaches PAGE to the zero frame and returns the zero frame
+   locked.  The caller must map it read-only. */
+struct frame *
+frame_zero_lock (struct page *page)
+{
+  lock_acquire (&zero_frame.lock);
+  frame_attach (&zero_frame, page);
+  return &zero_frame;
+}
+
+/* Returns true if F is the zero frame. */
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Locks PAGE's frame into memory, if it has one.
+   Upon return, either PAGE has no frame, or its frame is locked
+   by the current thread. */
+void
+frame_lock (struct page *p)
+{
+  /* A frame can be asynchronously removed, but never inserted. */
+  struct frame *f = p->frame;
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f != p->frame)
+        {
+          lock_release (&f->lock);
+          ASSERT (p->frame == NULL);
+        }
+    }
+}
+
+/* Adds page P to the pages using frame F and sets P's frame to
+   F.  F must be locked by the current thread. */
+void
+frame_attach (struct frame *f, struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt++;
+  p->frame = f;
+  count_page (f, p, 1);
+}
+
+/* Removes page P from the pages using frame F and clears P's
+   frame.  F must be locked by the current thread.  Unlike
+   frame_release(), leaves F locked and in the page cache even if
+   P was its last page. */
+void
+frame_detach (struct frame *f, struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (p->frame == f);
+
+  list_remove (&p->frame_elem);
+  f->ref_cnt--;
+  p->frame = NULL;
+  count_page (f, p, -1);
+}
+
+/* Removes page P from the pages using frame F, clears P's frame,
+   and unlocks F.  F becomes free if P was its last page.  F must
+   be locked by the current thread. */
+void
+frame_release (struct frame *f, struct page *p)
+{
+  frame_detach (f, p);
+  if (f->ref_cnt == 0)
+    uncache (f);
+  lock_release (&f->lock);
+}
+
+/* Evicts frame F, which must be locked by the current thread,
+   and unlocks it.  F keeps its pages if it cannot be evicted
+   because swap is full. */
+void
+frame_evict (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!frame_is_zero (f));
+
+  page_out (&f, 1);
+  if (f->ref_cnt == 0)
+    uncache (f);
+  lock_release (&f->lock);
+}
+
+/* Unlocks frame F, allowing it to be evicted.
+   F must be locked for use by the current thread. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Looks up the READ_BYTES bytes at offset OFS in INODE in the
+   page cache.  If they are there, attaches PAGE to the frame
+   that holds them and returns the frame locked.  Otherwise,
+   returns a null pointer. */
+struct frame *
+frame_cache_get (struct inode *inode, off_t ofs, size_t read_bytes,
+                 struct page *page)
+{
+  struct frame *f = cache_get (inode, ofs, read_bytes, page, true);
+  if (f != NULL)
+    cache_hit_cnt++;
+  else
+    cache_miss_cnt++;
+  return f;
+}
+
+/* Like frame_cache_get(), but fails instead of waiting if the
+   frame is locked, so that it may be called with another frame
+   locked. */
+struct frame *
+frame_cache_try_get (struct inode *inode, off_t ofs, size_t read_bytes,
+                     struct page *page)
+{
+  return cache_get (inode, ofs, read_bytes, page, false);
+}
+
+/* Looks up the READ_BYTES bytes at offset OFS in INODE in the
+   page cache for PAGE, waiting for the frame's lock if WAIT is
+   true. */
+static struct frame *
+cache_get (struct inode *inode, off_t ofs, size_t read_bytes,
+           struct page *page, bool wait)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&cache_lock);
+  e = hash_find (&cache, &key.cache_elem);
+  lock_release (&cache_lock);
+  if (e == NULL)
+    return NULL;
+
+  /* The frame may be evicted and reused while we wait for its
+     lock, so check that it still holds the same data. */
+  f = hash_entry (e, struct frame, cache_elem);
+  if (!wait)
+    {
+      if (!try_lock (f))
+        return NULL;
+    }
+  else
+    lock_acquire (&f->lock);
+  if (f->ref_cnt == 0 || f->inode != inode || f->ofs != ofs
+      || f->read_bytes != read_bytes)
+    {
+      lock_release (&f->lock);
+      return NULL;
+    }
+  frame_attach (f, page);
+  return f;
+}
+
+/* Enters frame F, which must be locked by the current thread and
+   hold the READ_BYTES bytes at offset OFS in INODE, into the page
+   cache, unless another frame already holds that data. */
+void
+frame_cache_add (struct frame *f, struct inode *inode, off_t ofs,
+                 size_t read_bytes)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode == NULL);
+
+  f->inode = inode;
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+  lock_acquire (&cache_lock);
+  if (hash_insert (&cache, &f->cache_elem) != NULL)
+    f->inode = NULL;
+  lock_release (&cache_lock);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  size_t used = 0, shared = 0, refs = 0;
+  size_t i;
+
+  for (i = 0; i < frame_cnt; i++)
+    if (frames[i].ref_cnt > 0)
+      {
+        used++;
+        refs += frames[i].ref_cnt;
+        if (frames[i].ref_cnt > 1)
+          shared++;
+      }
+  printf ("Frames: %zu of %zu in use, %zu shared, %zu pages mapped\n",
+          used, frame_cnt, shared, refs);
+  printf ("Frames: %zu pages map the zero frame\n", zero_frame.ref_cnt);
+  printf ("Frames: %llu evictions to enforce RSS limits\n", rss_evict_cnt);
+  printf ("Frames: page cache %llu hits, %llu misses\n",
+          cache_hit_cnt, cache_miss_cnt);
+}
+
+/* Removes frame F, which must be locked by the current thread,
+   from the page cache, if it is there. */
+static void
+uncache (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->inode != NULL)
+    {
+      lock_acquire (&cache_lock);
+      hash_delete (&cache, &f->cache_elem);
+      lock_release (&cache_lock);
+      f->inode = NULL;
+    }
+}
+
+/* Returns a hash value for the page cache entry E. */
+static unsigned
+cache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if page cache entry A precedes entry B. */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry (b_, struct frame, cache_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->read_bytes < b->read_bytes;
+}
+
+/* Adds DELTA to the RSS of page P's process for attaching P to,
+   or detaching it from, frame F. */
+static void
+count_page (struct frame *f, struct page *p, int delta)
+{
+  struct thread *t = p->thread;
+  enum intr_level old_level;
+
+  if (frame_is_zero (f))
+    return;
+
+  /* Any thread may attach or detach another process's pages. */
+  old_level = intr_disable ();
+  t->rss += delta;
+  if (t->rss > t->rss_peak)
+    t->rss_peak = t->rss;
+  intr_set_level (old_level);
+}
+
+/* Starts the thread that estimates working sets. */
+void
+frame_start_sampler (void)
+{
+  thread_create ("ws-sampler", PRI_DEFAULT, sampler, NULL);
+}
+
+/* Publishes thread T's working set estimate for the interval
+   that just ended.  Called through thread_foreach(). */
+static void
+publish_ws (struct thread *t, void *aux UNUSED)
+{
+  t->wss = t->wss_sample;
+  t->wss_sample = 0;
+}
+
+/* Every WS_INTERVAL, counts each process's pages that have been
+   accessed since the last time, as its working set. */
+static void
+sampler (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t i;
+
+      timer_sleep (WS_INTERVAL);
+
+      /* A frame that is locked is busy and gets counted next
+         time. */
+      for (i = 0; i < frame_cnt; i++)
+        {
+          struct frame *f = &frames[i];
+          struct list_elem *e;
+
+          if (!lock_try_acquire (&f->lock))
+            continue;
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            {
+              struct page *p = list_entry (e, struct page, frame_elem);
+              if (page_sample_accessed (p))
+                p->thread->wss_sample++;
+            }
+          lock_release (&f->lock);
+        }
+
+      old_level = intr_disable ();
+      thread_foreach (publish_ws, NULL);
+      intr_set_level (old_level);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+struct thread;
+
+/* Number of frames in a 4 MB page. */
+#define HUGE_FRAMES 1024
+
+/* A physical frame of the user pool.
+
+   A frame may hold a page shared by several processes, so it
+   keeps a list of the pages mapped to it and their number. */
+struct frame
+  {
+    struct lock lock;           /* Held while the frame is in use by
+                                   the kernel, which pins it. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Pages mapped here. */
+    size_t ref_cnt;             /* Number of pages in PAGES. */
+
+    /* Page cache entry, if INODE is nonnull: the frame holds
+       READ_BYTES bytes of INODE at offset OFS, then zeros. */
+    struct hash_elem cache_elem; /* Element in page cache. */
+    struct inode *inode;        /* Cached file. */
+    off_t ofs;                  /* Offset in INODE. */
+    size_t read_bytes;          /* Bytes read from INODE. */
+  };
+
+/* -rss: RSS limit for new processes, in pages, or 0 for none. */
+extern size_t frame_rss_limit;
+
+/* -ws: Report RSS and working set of each process at exit? */
+extern bool frame_ws_report;
+
+void frame_init (void);
+void frame_start_sampler (void);
+
+struct frame *frame_alloc_and_lock (struct page *);
+struct frame *frame_try_alloc_and_lock (struct page *);
+struct frame *frame_alloc_huge_and_lock (struct thread *);
+struct frame *frame_zero_lock (struct page *);
+bool frame_is_zero (const struct frame *);
+size_t frame_lock_limit (const struct thread *);
+void frame_lock (struct page *);
+void frame_attach (struct frame *, struct page *);
+void frame_detach (struct frame *, struct page *);
+void frame_release (struct frame *, struct page *);
+void frame_evict (struct frame *);
+void frame_unlock (struct frame *);
+
+struct frame *frame_cache_get (struct inode *, off_t, size_t read_bytes,
+                               struct page *);
+struct frame *frame_cache_try_get (struct inode *, off_t, size_t read_bytes,
+                                   struct page *);
+void frame_cache_add (struct frame *, struct inode *, off_t,
+                      size_t read_bytes);
+
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,134 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping makes the contents of a file appear in a contiguous
+   range of pages.  The pages are added to the supplemental page
+   table like those of an executable and faulted in on first
+   touch; modified pages are written back to the file when they
+   are evicted, when the mapping is removed, and at exit.  Each
+   mapping has its own reopened file, so closing or removing the
+   file the mapping was made from does not affect it. */
+
+/* A file mapping. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Mapped file. */
+    uint8_t *base;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space starting at
+   ADDR, which must be page-aligned.  The entire file is mapped,
+   and the part of the last page beyond the end of the file reads
+   as zeros and is not written back.  Returns the new mapping's
+   identifier, or MAP_FAILED if FILE is empty, ADDR is not a
+   suitable address, any page in the range is already in use, or
+   memory is exhausted. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+
+  length = file_length (m->file);
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  if (length == 0
+      || m->page_cnt > (size_t) ((uint8_t *) PHYS_BASE - m->base) / PGSIZE)
+    goto fail;
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap (m->base + ofs, m->file, ofs, read_bytes))
+        {
+          while (i-- > 0)
+            page_remove (m->base + i * PGSIZE);
+          goto fail;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+
+ fail:
+  file_close (m->file);
+  free (m);
+  return MAP_FAILED;
+}
+
+/* Removes the current process's mapping MAPID, writing modified
+   pages back to the file.  Does nothing if there is no such
+   mapping. */
+void
+mmap_unmap (mapid_t mapid)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapid)
+        {
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Removes all of the current process's mappings, writing
+   modified pages back.  Called at process exit. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
+
+/* Removes mapping M of the current process. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  list_remove (&m->elem);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
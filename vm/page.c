@@ -0,0 +1,1189 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Executables are loaded lazily.  load() in userprog/process.c
+   only records, for each page of each segment, where in the
+   executable its contents live.  Nothing is read and no memory
+   is allocated until the process first touches the page, at
+   which point page_fault() calls page_load() to bring it in.
+   Pages that a program never touches cost neither I/O nor
+   memory.
+
+   The stack starts out as a single page and grows on demand:
+   page_grow_stack() adds a page for a fault that looks like a
+   stack access, up to page_stack_limit bytes below PHYS_BASE.
+   Like everything else, the new page is only allocated when it
+   is loaded.
+
+   When physical memory runs short, the frame table evicts pages
+   through page_out().  A page whose contents can be recreated,
+   because it is unmodified file data or still all zeros, is
+   simply dropped.  A page of a memory-mapped file that has been
+   modified is written back to the file.  Any other page is
+   written to swap and read back by the next page_load().  Pages
+   are evicted in small batches so that they reach swap in a
+   single device request, and a page read back from swap brings
+   its neighbours from the same batch along with it.
+
+   Read-only pages of an executable are shared: every process
+   running the same program maps the same frame for a given page,
+   found through the frame table's page cache.  The executable
+   cannot be written while it runs (see load()), so the cached
+   data never goes stale.
+
+   fork() shares the parent's whole address space with the child
+   the same way: each resident page's frame gets the child's page
+   as well, and each swapped-out page's slot does too.  Shared
+   frames are mapped read-only, so the first write to a writable
+   one faults, and page_copy_on_write() gives the writer a copy
+   of its own.
+
+   A page that starts out as zeros, such as BSS or stack, is
+   mapped to the frame table's zero frame when it is first read,
+   and only gets a frame of its own when it is first written.
+   Large arrays that are mostly read, or not touched at all,
+   thus cost no memory.
+
+   A fault on a page of an executable also maps the surrounding
+   pages that happen to be in the page cache already (see
+   fault_around()), saving a fault for each of them.
+
+   Processes can describe how they will use their pages with
+   page_advise(), the madvise() system call: pages accessed
+   sequentially are read ahead of the faults, pages accessed at
+   random are not, and pages can be prefetched, evicted or
+   locked in memory on demand.
+
+   With -hp, a fault in a 4 MB-aligned stretch of address space
+   made up entirely of untouched, writable zero pages, such as a
+   big array in BSS, maps the whole stretch with a single 4 MB
+   page, if the frame table has 4 MB of suitably aligned memory
+   free (see page_in_huge()).  This saves the process a fault per
+   page, a page table, and most of its TLB misses there.  Each
+   page still has its own frame, so the rest of the VM system
+   treats the pages one by one; the 4 MB page is split into
+   ordinary pages when one of them has to be unmapped on its own,
+   e.g. for eviction. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void page_destructor (struct hash_elem *, void *aux);
+static struct page *page_add (void *upage, bool writable);
+static bool do_page_in (struct page *, bool write);
+static void swap_in_cluster (struct page *);
+static void page_release (struct page *);
+static void page_write_back (struct page *);
+static bool split_all (struct frame *);
+static void detach_all (struct frame *);
+static bool map_page (struct page *);
+static bool page_cacheable (const struct page *);
+static bool page_unshare (struct page *);
+static void fault_around (struct page *);
+static void read_ahead (struct page *);
+static bool page_prefetch (struct page *);
+static void page_drop (struct page *);
+static bool page_in_huge (struct page *);
+
+/* -sl: Maximum size of a user stack, in bytes. */
+size_t page_stack_limit = 8 * 1024 * 1024;
+
+/* Number of pages read ahead of a sequential access. */
+#define SEQUENTIAL_WINDOW 8
+
+/* -fa: Number of pages in the window that fault_around() maps
+   from the page cache on a fault; 0 or 1 disables it. */
+size_t page_fault_around = 16;
+
+/* -hp: Map suitable regions with 4 MB pages? */
+bool page_huge_pages;
+
+/* Statistics. */
+static unsigned long long fault_cnt, fault_cycles;
+static unsigned long long swap_fault_cnt, swap_fault_cycles;
+static unsigned long long readahead_cnt;
+static unsigned long long evict_cnt, evict_swap_cnt;
+static unsigned long long cow_fault_cnt, cow_copy_cnt;
+static unsigned long long zero_fault_cnt;
+static unsigned long long fault_around_cnt;
+static unsigned long long prefetch_cnt;
+static unsigned long long huge_cnt;
+
+/* Initializes the current thread's supplemental page table.
+   Returns true if successful, false on memory allocation
+   failure. */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Frees the current thread's supplemental page table, along
+   with the frames and swap slots of its pages.  Must be called
+   before the thread's page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&thread_current ()->pages, page_destructor);
+}
+
+/* Gives the current thread, which must have an empty
+   supplemental page table, a copy of the address space of
+   thread PARENT, which must be blocked.  The two share their
+   resident pages' frames and their swapped-out pages' slots
+   until one of them writes to a page.  Pages of the parent's
+   executable refer to EXEC_FILE instead in the copy.  File
+   mappings are not copied.  Returns true if successful, false on
+   memory allocation failure. */
+bool
+page_table_copy (struct thread *parent, struct file *exec_file)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *q;
+
+      if (p->mmap)
+        continue;
+
+      q = page_add (p->upage, p->writable);
+      if (q == NULL)
+        return false;
+      q->file = p->file != NULL ? exec_file : NULL;
+      q->file_ofs = p->file_ofs;
+      q->read_bytes = p->read_bytes;
+
+      frame_lock (p);
+      if (p->frame != NULL)
+        {
+          if (!pagedir_split (parent->pagedir, p->upage))
+            {
+              frame_unlock (p->frame);
+              return false;
+            }
+
+          /* From now on the frame holds data that only swap can
+             recreate, if the parent had modified it.  Remapping
+             the parent's page makes it read-only. */
+          if (pagedir_is_dirty (parent->pagedir, p->upage))
+            p->private = true;
+          q->private = p->private;
+          frame_attach (p->frame, q);
+          pagedir_clear_page (parent->pagedir, p->upage);
+          if (!map_page (p) || !map_page (q))
+            {
+              frame_unlock (p->frame);
+              return false;
+            }
+          frame_unlock (p->frame);
+        }
+      else if (p->sector != (block_sector_t) -1)
+        {
+          q->private = p->private;
+          swap_share (p, q);
+        }
+    }
+  return true;
+}
+
+/* Returns the current thread's page that contains UADDR, or a
+   null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&thread_current ()->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Adds a page at UPAGE to the current thread's address space
+   whose first READ_BYTES bytes are to be read from FILE at
+   offset OFS and whose remaining bytes are to be zeroed.  FILE
+   must stay open for as long as the page exists.  Returns true
+   if successful, false if UPAGE is already in use or memory is
+   exhausted. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds a page at UPAGE to the current thread's address space
+   that maps READ_BYTES bytes of FILE at offset OFS, followed by
+   zeros.  Unlike a page added with page_add_file(), changes to
+   the page are written back to FILE when it is evicted or
+   removed.  FILE must stay open for as long as the page exists.
+   Returns true if successful, false if UPAGE is already in use
+   or memory is exhausted. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->mmap = true;
+  return true;
+}
+
+/* Removes the current thread's page at UPAGE, which must exist,
+   writing it back to its file first if it is a modified page of
+   a memory-mapped file. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  page_release (p);
+}
+
+/* Adds an all-zero page at UPAGE to the current thread's address
+   space.  Returns true if successful, false if UPAGE is already
+   in use or memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, writable) != NULL;
+}
+
+/* Brings the page that contains FAULT_ADDR into memory and maps
+   it in the current thread's page directory.  WRITE is true if
+   the fault was caused by a write.  Returns true if successful,
+   storing in *TYPE where the page came from, false if FAULT_ADDR
+   is not part of the address space or the page could not be
+   loaded. */
+bool
+page_load (const void *fault_addr, bool write, enum fault_type *type)
+{
+  uint64_t start = rdtsc ();
+  bool paged_in, from_swap;
+  struct page *p;
+  uint64_t cycles;
+
+  p = page_lookup (fault_addr);
+  if (p == NULL)
+    return false;
+
+  frame_lock (p);
+  paged_in = p->frame == NULL;
+  from_swap = paged_in && p->sector != (block_sector_t) -1;
+  if (!paged_in)
+    *type = FAULT_MINOR;
+  else if (from_swap)
+    *type = FAULT_SWAP;
+  else if (p->file != NULL)
+    *type = FAULT_FILE;
+  else
+    *type = FAULT_ZERO;
+  if (paged_in && !page_in_huge (p) && !do_page_in (p, write))
+    return false;
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  frame_unlock (p->frame);
+  if (paged_in)
+    {
+      fault_around (p);
+      if (p->advice == MADV_SEQUENTIAL)
+        read_ahead (p);
+    }
+
+  cycles = rdtsc () - start;
+  fault_cnt++;
+  fault_cycles += cycles;
+  if (from_swap)
+    {
+      swap_fault_cnt++;
+      swap_fault_cycles += cycles;
+    }
+  return true;
+}
+
+/* Maps, along with page P, the pages of the same executable
+   around it that are not mapped in the current process but are
+   in the page cache, so that a process that runs through code
+   that other processes have already brought in does not fault
+   on every page.  The pages considered form an aligned window
+   of page_fault_around pages that contains P. */
+static void
+fault_around (struct page *p)
+{
+  size_t window = page_fault_around;
+  struct inode *inode;
+  uint8_t *upage;
+  size_t i;
+
+  if (window < 2 || p->advice == MADV_RANDOM || !page_cacheable (p))
+    return;
+
+  inode = file_get_inode (p->file);
+  upage = (uint8_t *) p->upage - pg_no (p->upage) % window * PGSIZE;
+  for (i = 0; i < window && is_user_vaddr (upage); i++, upage += PGSIZE)
+    {
+      struct page *q = page_lookup (upage);
+
+      /* Only the current thread adds a frame to its pages, so
+         Q's frame cannot appear behind our back.  Frames of
+         other pages are only tried, never waited for. */
+      if (q == NULL || q == p || q->frame != NULL || !page_cacheable (q)
+          || file_get_inode (q->file) != inode
+          || frame_cache_try_get (inode, q->file_ofs, q->read_bytes, q)
+             == NULL)
+        continue;
+      if (map_page (q))
+        {
+          fault_around_cnt++;
+          frame_unlock (q->frame);
+        }
+      else
+        frame_release (q->frame, q);
+    }
+}
+
+/* Brings in the SEQUENTIAL_WINDOW pages after page P, which has
+   just been faulted in by a process that declared sequential
+   access, ahead of time.  The page as far behind P becomes the
+   clock's first choice for eviction, since it will most likely
+   not be used again. */
+static void
+read_ahead (struct page *p)
+{
+  uint8_t *upage = p->upage;
+  struct page *q;
+  size_t i;
+
+  for (i = 1; i <= SEQUENTIAL_WINDOW; i++)
+    {
+      q = page_lookup (upage + i * PGSIZE);
+      if (q == NULL || q->advice != MADV_SEQUENTIAL || !page_prefetch (q))
+        break;
+    }
+
+  q = page_lookup (upage - SEQUENTIAL_WINDOW * PGSIZE);
+  if (q != NULL && q->advice == MADV_SEQUENTIAL)
+    {
+      frame_lock (q);
+      if (q->frame != NULL)
+        {
+          pagedir_set_accessed (q->thread->pagedir, q->upage, false);
+          q->referenced = false;
+          frame_unlock (q->frame);
+        }
+    }
+}
+
+/* Brings page P of the current thread into memory, if it is not
+   there already.  Returns true if successful, false if no frame
+   could be obtained. */
+static bool
+page_prefetch (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame == NULL)
+    {
+      if (!do_page_in (p, false))
+        return false;
+      prefetch_cnt++;
+    }
+  frame_unlock (p->frame);
+  return true;
+}
+
+/* Evicts page P of the current thread, unless it is locked into
+   memory.  A page that shares its frame lets go of the frame,
+   if its contents can be recreated, and leaves the frame to the
+   other pages. */
+static void
+page_drop (struct page *p)
+{
+  struct frame *f;
+
+  frame_lock (p);
+  f = p->frame;
+  if (f == NULL)
+    return;
+  if (p->locked)
+    frame_unlock (f);
+  else if (frame_is_zero (f) || (f->ref_cnt > 1 && !p->private))
+    {
+      pagedir_clear_page (p->thread->pagedir, p->upage);
+      frame_release (f, p);
+    }
+  else if (f->ref_cnt == 1)
+    frame_evict (f);
+  else
+    frame_unlock (f);
+}
+
+/* Applies ADVICE to the LENGTH bytes of the current thread's
+   address space starting at ADDR, which must be page-aligned
+   and lie entirely within its pages.  MADV_RANDOM and
+   MADV_SEQUENTIAL steer readahead on later faults, and
+   MADV_NORMAL restores the default.  MADV_WILLNEED and
+   MADV_DONTNEED bring the pages in or evict them right away.
+   MADV_LOCK brings the pages in and keeps them in memory until
+   MADV_UNLOCK, as long as the thread stays within
+   frame_lock_limit() locked pages.  Returns true if successful,
+   false if the arguments are invalid, the thread would lock too
+   many pages, or memory is exhausted. */
+bool
+page_advise (void *addr, size_t length, enum page_advice advice)
+{
+  struct thread *cur = thread_current ();
+  uint8_t *start = addr;
+  uint8_t *end, *upage;
+  size_t new_locked = 0;
+
+  if (pg_ofs (start) != 0 || !is_user_vaddr (start)
+      || length > (size_t) ((uint8_t *) PHYS_BASE - start)
+      || (int) advice < MADV_NORMAL || (int) advice > MADV_UNLOCK)
+    return false;
+
+  end = start + length;
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+      if (p == NULL)
+        return false;
+      if (!p->locked)
+        new_locked++;
+    }
+
+  /* Locked pages cannot be evicted, so a process that locked
+     too many would leave everyone else short of frames. */
+  if (advice == MADV_LOCK
+      && cur->locked_cnt + new_locked > frame_lock_limit (cur))
+    return false;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+
+      switch (advice)
+        {
+        case MADV_NORMAL:
+        case MADV_RANDOM:
+        case MADV_SEQUENTIAL:
+          p->advice = advice;
+          break;
+
+        case MADV_WILLNEED:
+          if (!page_prefetch (p))
+            return false;
+          break;
+
+        case MADV_DONTNEED:
+          page_drop (p);
+          break;
+
+        case MADV_LOCK:
+          frame_lock (p);
+          if (p->frame == NULL && !do_page_in (p, false))
+            return false;
+          if (!p->locked)
+            {
+              p->locked = true;
+              cur->locked_cnt++;
+            }
+          frame_unlock (p->frame);
+          break;
+
+        case MADV_UNLOCK:
+          /* A page that is not in memory need not be brought in
+             just to be unlocked. */
+          frame_lock (p);
+          if (p->locked)
+            {
+              p->locked = false;
+              cur->locked_cnt--;
+            }
+          if (p->frame != NULL)
+            frame_unlock (p->frame);
+          break;
+        }
+    }
+  return true;
+}
+
+/* Handles a write to the current thread's page that contains
+   FAULT_ADDR, which faulted because the page was mapped
+   read-only.  If the page is writable, it was shared, and the
+   current thread gets a private copy of the page, or the
+   existing frame if no other page uses it any more.  Returns
+   true if successful, false if the page may not be written or
+   memory is exhausted. */
+bool
+page_copy_on_write (const void *fault_addr)
+{
+  struct page *p = page_lookup (fault_addr);
+  bool success;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  /* The page may have been evicted in the meantime. */
+  frame_lock (p);
+  if (p->frame == NULL && !do_page_in (p, true))
+    return false;
+  success = page_unshare (p);
+  frame_unlock (p->frame);
+  if (success)
+    cow_fault_cnt++;
+  return success;
+}
+
+/* Adds a zeroed, writable page to the current thread's stack to
+   hold UADDR, if UADDR looks like a stack access given the user
+   stack pointer ESP: no more than 32 bytes below ESP, as PUSHA
+   may write, and within page_stack_limit bytes of the top of
+   user memory.  Returns true if a page was added. */
+bool
+page_grow_stack (const void *uaddr, const void *esp)
+{
+  const uint8_t *addr = uaddr;
+
+  if (!is_user_vaddr (addr)
+      || addr < (const uint8_t *) PHYS_BASE - page_stack_limit
+      || addr + 32 < (const uint8_t *) esp)
+    return false;
+  return page_add_zero (pg_round_down (addr), true);
+}
+
+/* Brings the page that contains UADDR into memory, if necessary,
+   and locks it there, so that the kernel may access it without
+   faulting, e.g. while holding a lock that a page fault would
+   need.  Grows the stack if UADDR is just below the user stack
+   pointer.  If WILL_WRITE is true, the page must be writable.
+   Returns true if successful, false if UADDR is not accessible
+   in the way requested.  page_unlock() releases the page.
+
+   A page that is only read and still maps the shared zero frame
+   is not locked, because holding the zero frame's lock would
+   hold up every other zero-page fault for as long as the caller
+   keeps the page.  The zero frame never moves, and if the page
+   is detached from it in the meantime, faulting it back in does
+   no I/O and takes no lock that the caller could hold. */
+bool
+page_lock (const void *uaddr, bool will_write)
+{
+  struct page *p = page_lookup (uaddr);
+  if (p == NULL && page_grow_stack (uaddr, thread_current ()->user_esp))
+    p = page_lookup (uaddr);
+  if (p == NULL || (will_write && !p->writable))
+    return false;
+
+  frame_lock (p);
+  if (p->frame == NULL && !do_page_in (p, will_write))
+    return false;
+
+  if (!will_write && frame_is_zero (p->frame))
+    {
+      frame_unlock (p->frame);
+      return true;
+    }
+
+  /* The kernel may not take a copy-on-write fault on a page
+     whose frame it holds locked, so break the sharing now. */
+  if (will_write && !page_unshare (p))
+    {
+      frame_unlock (p->frame);
+      return false;
+    }
+  return true;
+}
+
+/* Unlocks the page that contains UADDR, which must have been
+   locked with page_lock(). */
+void
+page_unlock (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+  ASSERT (p != NULL);
+
+  /* A zero page that page_lock() left unlocked may since have
+     been detached from the zero frame, or faulted back in. */
+  if (p->frame != NULL && lock_held_by_current_thread (&p->frame->lock))
+    frame_unlock (p->frame);
+}
+
+/* Returns true if page P has been accessed since the last call,
+   clearing its accessed bit.  P's frame must be locked by the
+   current thread. */
+bool
+page_accessed_recently (struct page *p)
+{
+  bool accessed;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  accessed = page_sample_accessed (p) || p->referenced;
+  p->referenced = false;
+  return accessed;
+}
+
+/* Returns true if page P has been accessed since the last call
+   to this function or page_accessed_recently(), for estimating
+   working sets.  The page's accessed bit is cleared, but the
+   access is remembered for page_accessed_recently().  P's frame
+   must be locked by the current thread. */
+bool
+page_sample_accessed (struct page *p)
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  if (!pagedir_is_accessed (p->thread->pagedir, p->upage))
+    return false;
+  pagedir_set_accessed (p->thread->pagedir, p->upage, false);
+  p->referenced = true;
+  return true;
+}
+
+/* Returns true if evicting page P would write it to swap.  P's
+   frame must be locked by the current thread. */
+bool
+page_needs_swap (struct page *p)
+{
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  return !p->mmap && (p->private
+                      || pagedir_is_dirty (p->thread->pagedir, p->upage));
+}
+
+/* Evicts the CNT frames in FRAMES, at most SWAP_CLUSTER, which
+   must be locked by the current thread.  Each frame's pages are
+   unmapped.  Frames whose contents cannot be recreated are
+   written to swap together.  A frame that cannot be evicted,
+   because swap is full or memory to split a 4 MB page is not
+   available, keeps its pages; the others end up with
+   none.  Once a page has let go of its frame, it may be freed by
+   its owner at any time, so it is not touched again. */
+void
+page_out (struct frame **frames, size_t cnt)
+{
+  struct frame *swapped[SWAP_CLUSTER];
+  size_t swap_cnt = 0;
+  size_t written;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frames[i];
+      bool private = false;
+      struct list_elem *e;
+
+      ASSERT (lock_held_by_current_thread (&f->lock));
+
+      /* A page that is part of a 4 MB page can only be unmapped
+         by itself after splitting the 4 MB page, which takes
+         memory. */
+      if (!split_all (f))
+        continue;
+
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+
+          /* Unmap the page first, so that the process faults, and
+             waits on the frame lock, if it touches the page from
+             now on.  This also makes the dirty bit stable. */
+          pagedir_clear_page (p->thread->pagedir, p->upage);
+
+          /* Once modified, a page's contents live in swap for
+             good, unless it belongs to a file mapping. */
+          if (pagedir_is_dirty (p->thread->pagedir, p->upage))
+            {
+              if (p->mmap)
+                page_write_back (p);
+              else
+                p->private = true;
+            }
+          if (p->private)
+            private = true;
+        }
+
+      if (private)
+        swapped[swap_cnt++] = f;
+      else
+        {
+          evict_cnt++;
+          detach_all (f);
+        }
+    }
+
+  written = swap_cnt > 0 ? swap_out (swapped, swap_cnt) : 0;
+  for (i = 0; i < swap_cnt; i++)
+    {
+      struct frame *f = swapped[i];
+      if (i < written)
+        {
+          struct list_elem *e;
+
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            list_entry (e, struct page, frame_elem)->private = true;
+          evict_cnt++;
+          evict_swap_cnt++;
+          detach_all (f);
+        }
+      else
+        {
+          struct list_elem *e;
+
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            map_page (list_entry (e, struct page, frame_elem));
+        }
+    }
+}
+
+/* Splits the 4 MB pages, if any, that the pages of frame F, which
+   must be locked by the current thread, are part of.  Returns
+   true if successful, false if memory allocation failed. */
+static bool
+split_all (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (!pagedir_split (p->thread->pagedir, p->upage))
+        return false;
+    }
+  return true;
+}
+
+/* Removes all the pages from frame F, which must be locked by the
+   current thread and unmapped from all of them. */
+static void
+detach_all (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    frame_detach (f, list_entry (list_front (&f->pages),
+                                 struct page, frame_elem));
+}
+
+/* Maps page P to its frame, which must be locked by the current
+   thread, in P's page directory.  The mapping is read-only if
+   the frame is shared, so that a write faults.  Returns true if
+   successful, false on failure. */
+static bool
+map_page (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  return pagedir_set_page (p->thread->pagedir, p->upage, p->frame->base,
+                           p->writable && p->frame->ref_cnt == 1
+                           && !frame_is_zero (p->frame));
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %llu faults (%llu cycles each), "
+          "%llu from swap (%llu cycles each)\n",
+          fault_cnt, fault_cnt > 0 ? fault_cycles / fault_cnt : 0,
+          swap_fault_cnt,
+          swap_fault_cnt > 0 ? swap_fault_cycles / swap_fault_cnt : 0);
+  printf ("Paging: %llu pages evicted, %llu to swap, %llu read ahead\n",
+          evict_cnt, evict_swap_cnt, readahead_cnt);
+  printf ("Paging: %llu copy-on-write faults, %llu pages copied, "
+          "%llu faults mapped the zero frame\n",
+          cow_fault_cnt, cow_copy_cnt, zero_fault_cnt);
+  printf ("Paging: %llu faults avoided by mapping pages around faults, "
+          "%llu pages prefetched\n", fault_around_cnt, prefetch_cnt);
+  printf ("Paging: %llu 4 MB pages mapped\n", huge_cnt);
+}
+
+/* Allocates a frame for page P, fills it, and maps it.  A
+   read-only page of an executable shares the frame that already
+   holds its data, if there is one.  Unless WRITE is true, a page
+   that is still all zeros gets the zero frame.  Returns true with
+   P's frame locked if successful, false on failure. */
+static bool
+do_page_in (struct page *p, bool write)
+{
+  bool cacheable = page_cacheable (p);
+  struct inode *inode = cacheable ? file_get_inode (p->file) : NULL;
+
+  if (!write && p->file == NULL && !p->private
+      && p->sector == (block_sector_t) -1)
+    {
+      frame_zero_lock (p);
+      if (!map_page (p))
+        goto fail;
+      zero_fault_cnt++;
+      return true;
+    }
+
+  if (cacheable
+      && frame_cache_get (inode, p->file_ofs, p->read_bytes, p) != NULL)
+    {
+      if (!map_page (p))
+        goto fail;
+      return true;
+    }
+
+  if (frame_alloc_and_lock (p) == NULL)
+    return false;
+
+  if (p->sector != (block_sector_t) -1)
+    swap_in_cluster (p);
+  else
+    {
+      uint8_t *kpage = p->frame->base;
+      if (p->file != NULL
+          && file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+             != (off_t) p->read_bytes)
+        goto fail;
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+  if (!map_page (p))
+    goto fail;
+  if (p->sector != (block_sector_t) -1)
+    swap_discard (p);
+  if (cacheable)
+    frame_cache_add (p->frame, inode, p->file_ofs, p->read_bytes);
+  return true;
+
+ fail:
+  frame_release (p->frame, p);
+  return false;
+}
+
+/* Returns true if page P may become part of a 4 MB page: it must
+   be a writable page that is still all zeros, and either not
+   resident or mapped to the zero frame. */
+static bool
+page_hugeable (const struct page *p)
+{
+  return (p->writable && p->file == NULL && !p->private && !p->locked
+          && p->advice == MADV_NORMAL && p->sector == (block_sector_t) -1
+          && (p->frame == NULL || frame_is_zero (p->frame)));
+}
+
+/* Tries to bring page P, which has no frame, into memory as part
+   of a 4 MB page that maps the 4 MB-aligned stretch of address
+   space around it, which must consist of pages that
+   page_hugeable() accepts.  Returns true with P's frame locked if
+   successful.  Returns false if -hp is not in effect, the pages
+   do not qualify, or 4 MB of contiguous memory is not free, in
+   which case nothing has changed and P should be brought in by
+   itself. */
+static bool
+page_in_huge (struct page *p)
+{
+  uint8_t *base = (uint8_t *) ((uintptr_t) p->upage & PDMASK);
+  uint32_t *pd = p->thread->pagedir;
+  struct frame *first;
+  size_t i;
+
+  ASSERT (p->frame == NULL);
+
+  if (!page_huge_pages)
+    return false;
+
+  /* Check the ends first, which rules out most regions
+     cheaply. */
+  for (i = 0; i < HUGE_FRAMES; i++)
+    {
+      size_t j = i < 2 ? i * (HUGE_FRAMES - 1) : i - 1;
+      struct page *q = page_lookup (base + j * PGSIZE);
+      if (q == NULL || !page_hugeable (q))
+        return false;
+    }
+
+  first = frame_alloc_huge_and_lock (p->thread);
+  if (first == NULL)
+    return false;
+
+  /* Only the current thread attaches frames to its pages, and
+     the zero frame never goes away, so the pages still qualify.
+     Those that were reading the zero frame let go of it. */
+  memset (first->base, 0, PTSPAN);
+  for (i = 0; i < HUGE_FRAMES; i++)
+    {
+      struct page *q = page_lookup (base + i * PGSIZE);
+      if (q->frame != NULL)
+        {
+          frame_lock (q);
+          pagedir_clear_page (pd, q->upage);
+          frame_release (q->frame, q);
+        }
+      frame_attach (first + i, q);
+    }
+
+  if (!pagedir_set_huge_page (pd, base, first->base, true))
+    {
+      for (i = 0; i < HUGE_FRAMES; i++)
+        frame_release (first + i, page_lookup (base + i * PGSIZE));
+      return false;
+    }
+
+  for (i = 0; i < HUGE_FRAMES; i++)
+    if (first + i != p->frame)
+      frame_unlock (first + i);
+  huge_cnt++;
+  return true;
+}
+
+/* Ensures that page P, whose frame is locked by the current
+   thread, has a frame of its own and is mapped writable,
+   copying the frame if other pages share it.  Returns true if
+   successful, false if no frame can be obtained for the copy,
+   in which case P keeps the shared frame. */
+static bool
+page_unshare (struct page *p)
+{
+  struct frame *shared = p->frame;
+
+  ASSERT (p->writable);
+  ASSERT (lock_held_by_current_thread (&shared->lock));
+
+  if (frame_is_zero (shared))
+    {
+      /* The zero frame never moves, so there is no need to keep
+         it locked, which would hold up everyone else's zero
+         pages, while P gets a frame of its own. */
+      frame_release (shared, p);
+      if (frame_alloc_and_lock (p) == NULL)
+        {
+          frame_zero_lock (p);
+          return false;
+        }
+      memset (p->frame->base, 0, PGSIZE);
+      cow_copy_cnt++;
+    }
+  else if (shared->ref_cnt > 1)
+    {
+      /* Keep SHARED locked, so that it stays put, while P gets
+         and fills a new frame. */
+      frame_detach (shared, p);
+      if (frame_alloc_and_lock (p) == NULL)
+        {
+          frame_attach (shared, p);
+          return false;
+        }
+      memcpy (p->frame->base, shared->base, PGSIZE);
+      frame_unlock (shared);
+      cow_copy_cnt++;
+    }
+  else if (pagedir_is_writable (p->thread->pagedir, p->upage))
+    return true;
+
+  pagedir_clear_page (p->thread->pagedir, p->upage);
+  return map_page (p);
+}
+
+/* Returns true if page P can share its frame through the page
+   cache: it must be an unmodified, read-only page of a file. */
+static bool
+page_cacheable (const struct page *p)
+{
+  return (p->file != NULL && !p->writable && !p->mmap && !p->private
+          && p->sector == (block_sector_t) -1);
+}
+
+/* Returns true if page Q, a swapped-out page of the current
+   process, can be read ahead, allocating and locking a frame for
+   it if so.  Readahead only uses free frames: it never evicts. */
+static bool
+readahead_frame (struct page *q)
+{
+  /* A page still being written out has a frame until the write
+     completes. */
+  if (q->frame != NULL)
+    return false;
+  return frame_try_alloc_and_lock (q) != NULL;
+}
+
+/* Reads page P, whose frame is locked, back from swap.  The
+   pages of the same process that sit in adjacent slots of P's
+   swap cluster are read in the same request, as long as free
+   frames last, and mapped without their accessed bits set, so
+   that the clock reclaims them first if they go unused. */
+static void
+swap_in_cluster (struct page *p)
+{
+  /* P is at RUN[SWAP_CLUSTER - 1]; the run grows both ways. */
+  struct page *run[2 * SWAP_CLUSTER - 1];
+  size_t first = SWAP_CLUSTER - 1;
+  size_t end = SWAP_CLUSTER;
+  struct page *q;
+  size_t i;
+
+  run[first] = p;
+
+  /* Neighbours are of no use to a process that accesses its
+     pages at random. */
+  if (p->advice != MADV_RANDOM)
+    {
+      while (first > 0
+             && (q = swap_neighbor (p, (int) first - SWAP_CLUSTER)) != NULL
+             && readahead_frame (q))
+        run[--first] = q;
+      while (end < 2 * SWAP_CLUSTER - 1
+             && (q = swap_neighbor (p, (int) end - SWAP_CLUSTER + 1)) != NULL
+             && readahead_frame (q))
+        run[end++] = q;
+    }
+
+  swap_in (run + first, end - first);
+
+  for (i = first; i < end; i++)
+    {
+      q = run[i];
+      if (q == p)
+        continue;
+      if (map_page (q))
+        {
+          swap_discard (q);
+          readahead_cnt++;
+          frame_unlock (q->frame);
+        }
+      else
+        {
+          /* Its slot still holds the data. */
+          frame_release (q->frame, q);
+        }
+    }
+}
+
+/* Creates and inserts a page at UPAGE with no initial contents
+   yet.  Returns the new page, or a null pointer if UPAGE is
+   already in use or memory is exhausted. */
+static struct page *
+page_add (void *upage, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->thread = thread_current ();
+  p->frame = NULL;
+  p->sector = (block_sector_t) -1;
+  p->private = false;
+  p->mmap = false;
+  p->locked = false;
+  p->referenced = false;
+  p->advice = MADV_NORMAL;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees the page that E refers to. */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED)
+{
+  page_release (hash_entry (e, struct page, hash_elem));
+}
+
+/* Writes page P, a page of a memory-mapped file, back to its
+   file.  P's frame must be locked by the current thread. */
+static void
+page_write_back (struct page *p)
+{
+  ASSERT (p->mmap);
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  file_write_at (p->file, p->frame->base, p->read_bytes, p->file_ofs);
+}
+
+/* Frees page P, which must already be out of its thread's page
+   table, with its frame and swap slot.  A modified page of a
+   memory-mapped file is written back first. */
+static void
+page_release (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (p->thread->pagedir, p->upage);
+      if (p->mmap && pagedir_is_dirty (p->thread->pagedir, p->upage))
+        page_write_back (p);
+      frame_release (p->frame, p);
+    }
+  if (p->sector != (block_sector_t) -1)
+    swap_discard (p);
+  if (p->locked)
+    p->thread->locked_cnt--;
+  free (p);
+}
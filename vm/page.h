@@ -0,0 +1,100 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+#include "userprog/exception.h"
+
+struct frame;
+struct thread;
+
+/* Advice for page_advise(), as in lib/user/syscall.h. */
+enum page_advice
+  {
+    MADV_NORMAL,                /* No special treatment. */
+    MADV_RANDOM,                /* Expect random access: no readahead. */
+    MADV_SEQUENTIAL,            /* Expect sequential access. */
+    MADV_WILLNEED,              /* Bring the pages in now. */
+    MADV_DONTNEED,              /* Evict the pages now. */
+    MADV_LOCK,                  /* Keep the pages in memory. */
+    MADV_UNLOCK                 /* Undo MADV_LOCK. */
+  };
+
+/* A page of a process's virtual address space.
+
+   Each user page that a process may legitimately touch has an
+   entry in the process's supplemental page table, whether or
+   not it is currently present in the hardware page table.  The
+   entry records where the page's contents come from, so that
+   page_load() can bring it in on first access, and where they
+   went if the page was evicted.
+
+   FRAME, FRAME_ELEM, SECTOR, PRIVATE, LOCKED and REFERENCED may
+   only be changed by a thread that holds the lock on the page's
+   frame (see vm/frame.c). */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    bool writable;              /* Writable by the user process? */
+    struct thread *thread;      /* Owning thread. */
+    struct hash_elem hash_elem; /* Element in thread's `pages' table. */
+
+    struct frame *frame;        /* Page frame, or null if not resident. */
+    struct list_elem frame_elem; /* Element in frame's `pages' list. */
+    block_sector_t sector;      /* First swap sector, or -1. */
+    bool private;               /* True: evict to swap even if clean. */
+    bool mmap;                  /* Part of a file mapping? */
+    bool locked;                /* Never evicted (MADV_LOCK)? */
+    bool referenced;            /* Accessed bit saved by the working
+                                   set sampler. */
+    enum page_advice advice;    /* MADV_NORMAL, MADV_RANDOM, or
+                                   MADV_SEQUENTIAL. */
+
+    /* Initial contents: READ_BYTES bytes from FILE at FILE_OFS,
+       followed by zeros.  FILE is null for an all-zero page.  For
+       a page of a file mapping, the same bytes are written back
+       when the page is modified. */
+    struct file *file;          /* Backing file, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest is zeroed. */
+  };
+
+/* -sl: Maximum size of a user stack, in bytes. */
+extern size_t page_stack_limit;
+
+/* -fa: Pages in the fault-around window. */
+extern size_t page_fault_around;
+
+/* -hp: Map suitable regions with 4 MB pages? */
+extern bool page_huge_pages;
+
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_table_copy (struct thread *parent, struct file *exec_file);
+
+struct page *page_lookup (const void *uaddr);
+bool page_add_file (void *upage, struct file *, off_t, size_t read_bytes,
+                    bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t, size_t read_bytes);
+bool page_add_zero (void *upage, bool writable);
+void page_remove (void *upage);
+bool page_load (const void *fault_addr, bool write, enum fault_type *);
+bool page_grow_stack (const void *uaddr, const void *esp);
+bool page_copy_on_write (const void *fault_addr);
+
+bool page_lock (const void *uaddr, bool will_write);
+void page_unlock (const void *uaddr);
+bool page_advise (void *addr, size_t length, enum page_advice);
+
+bool page_accessed_recently (struct page *);
+bool page_sample_accessed (struct page *);
+bool page_needs_swap (struct page *);
+void page_out (struct frame **, size_t cnt);
+
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,470 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/memtrack.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Swap space.
+
+   The BLOCK_SWAP device is divided into page-sized slots of
+   PAGE_SECTORS consecutive sectors each, and a bitmap records
+   which slots are in use.  Each evicted page that has to be
+   saved occupies one slot until it is read back in or its
+   process exits.
+
+   Pages are written out in batches.  A batch gets a run of
+   adjacent slots, allocated next-fit so that successive batches
+   also land next to each other, and is written with a single
+   device request.  Slots are grouped into aligned clusters of
+   SWAP_CLUSTER slots; when a page is read back in, its
+   neighbours in the same cluster are good candidates for
+   readahead, since they were probably evicted together.
+
+   A frame shared by several pages after fork() goes to a single
+   slot, which each of those pages refers to.  The slot is freed
+   when the last of them is read back in or released.  A shared
+   slot has no owner and is never read ahead.
+
+   Writing to the disk is slow, so a page bound for swap is
+   first compressed and kept in the compressed pool in kernel
+   memory, as long as it compresses well and the pool has room.
+   The page still gets a slot, but its contents only reach the
+   slot on the disk when the pool fills up and the page is one of
+   the oldest in it.  Reading it back from the pool just takes
+   decompression. */
+
+/* The swap device. */
+static struct block *swap_device;
+
+/* Used swap slots. */
+static struct bitmap *swap_bitmap;
+
+/* Page stored in each used slot, or null if it is shared. */
+static struct page **swap_owners;
+
+/* Number of pages that refer to each used slot. */
+static unsigned *swap_ref_cnts;
+
+/* Slot at which to start looking for free slots. */
+static size_t swap_hint;
+
+/* A page held compressed in the pool. */
+struct zpage
+  {
+    struct list_elem elem;      /* Element in zpool_lru. */
+    size_t slot;                /* Slot that the page belongs in. */
+    bool writing;               /* Being written back to SLOT? */
+    bool discarded;             /* Slot freed while being written? */
+    size_t size;                /* Size of DATA in bytes. */
+    uint8_t data[];             /* Compressed contents. */
+  };
+
+/* Largest compressed page worth keeping in the pool. */
+#define ZPAGE_MAX (PGSIZE * 3 / 4)
+
+/* -zs: Size limit of the compressed pool, in bytes. */
+size_t swap_pool_limit = 256 * 1024;
+
+/* Compressed page held for each used slot, or null if the slot's
+   contents are on the disk. */
+static struct zpage **swap_zpages;
+
+/* Compressed pages, oldest first, and their total size. */
+static struct list zpool_lru;
+static size_t zpool_bytes;
+
+/* Buffers for compression and decompression. */
+static uint8_t zbuf[ZPAGE_MAX];
+static uint8_t zwork[LZ_WORK_SIZE];
+
+/* Protects swap_bitmap, swap_owners, swap_ref_cnts, swap_hint,
+   and the compressed pool. */
+static struct lock swap_lock;
+
+/* Statistics. */
+static unsigned long long out_req_cnt, out_page_cnt;
+static unsigned long long in_req_cnt, in_page_cnt;
+static unsigned long long zpool_out_cnt, zpool_in_cnt;
+static unsigned long long zpool_reject_cnt, zpool_writeback_cnt;
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Sets up swap. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    printf ("no swap device--swap disabled\n");
+  else
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+
+  swap_bitmap = bitmap_create (slot_cnt);
+  swap_owners = calloc (slot_cnt + 1, sizeof *swap_owners);
+  swap_ref_cnts = calloc (slot_cnt + 1, sizeof *swap_ref_cnts);
+  swap_zpages = calloc (slot_cnt + 1, sizeof *swap_zpages);
+  if (swap_bitmap == NULL || swap_owners == NULL || swap_ref_cnts == NULL
+      || swap_zpages == NULL)
+    PANIC ("couldn't create swap bitmap");
+  list_init (&zpool_lru);
+}
+
+/* Writes the oldest page in the compressed pool to its slot on
+   the disk and frees it.  Returns false, without doing anything,
+   if the pool is empty or there is no memory to decompress into.
+   Must be called with swap_lock held, but releases it during the
+   write, so that swap-ins and swap-outs need not wait for the
+   disk.  Until the write is done, the page stays where swap_in()
+   can find it, and its slot stays allocated even if the page is
+   discarded, so that the write cannot land in a reused slot. */
+static bool
+zpool_write_back (void)
+{
+  struct zpage *z;
+  struct block_iovec iov;
+  void *buf;
+  size_t size;
+
+  if (list_empty (&zpool_lru))
+    return false;
+  buf = palloc_get_page (0);
+  if (buf == NULL)
+    return false;
+
+  z = list_entry (list_pop_front (&zpool_lru), struct zpage, elem);
+  zpool_bytes -= z->size;
+  z->writing = true;
+  size = lz_decompress (z->data, z->size, buf, PGSIZE);
+  ASSERT (size == PGSIZE);
+
+  lock_release (&swap_lock);
+  iov.buffer = buf;
+  iov.sector_cnt = PAGE_SECTORS;
+  block_writev (swap_device, z->slot * PAGE_SECTORS, &iov, 1);
+  lock_acquire (&swap_lock);
+
+  out_req_cnt++;
+  out_page_cnt++;
+  zpool_writeback_cnt++;
+  if (z->discarded)
+    bitmap_reset (swap_bitmap, z->slot);
+  else
+    swap_zpages[z->slot] = NULL;
+  free (z);
+  palloc_free_page (buf);
+  return true;
+}
+
+/* Tries to store the page at KPAGE, destined for SLOT, in the
+   compressed pool, writing the oldest pages in the pool to disk
+   to make room if necessary.  Returns true if successful, false
+   if the page must be written to disk instead.  Must be called
+   with swap_lock held, which may be released and reacquired. */
+static bool
+zpool_store (size_t slot, const void *kpage)
+{
+  struct zpage *z;
+  size_t size;
+
+  if (swap_pool_limit == 0)
+    return false;
+
+  size = lz_compress (kpage, PGSIZE, zbuf, sizeof zbuf, zwork);
+  if (size == 0 || size > swap_pool_limit)
+    {
+      zpool_reject_cnt++;
+      return false;
+    }
+
+  /* Copy out of ZBUF before making room, which lets other
+     threads at it. */
+  z = malloc (sizeof *z + size);
+  if (z == NULL)
+    return false;
+
+  /* The page is not necessarily the current process's, and its
+     copy may outlive the current process. */
+  if (memtrack_enabled)
+    memtrack_disown (z);
+  z->slot = slot;
+  z->writing = false;
+  z->discarded = false;
+  z->size = size;
+  memcpy (z->data, zbuf, size);
+
+  while (zpool_bytes + size > swap_pool_limit)
+    if (!zpool_write_back ())
+      {
+        free (z);
+        return false;
+      }
+  list_push_back (&zpool_lru, &z->elem);
+  zpool_bytes += size;
+  swap_zpages[slot] = z;
+  zpool_out_cnt++;
+  return true;
+}
+
+/* Removes the page for SLOT from the compressed pool, if it is
+   there.  Returns true if SLOT may be freed now, false if its
+   page is being written back, in which case zpool_write_back()
+   frees the slot when it is done.  Must be called with swap_lock
+   held. */
+static bool
+zpool_discard (size_t slot)
+{
+  struct zpage *z = swap_zpages[slot];
+
+  if (z == NULL)
+    return true;
+  swap_zpages[slot] = NULL;
+  if (z->writing)
+    {
+      z->discarded = true;
+      return false;
+    }
+  list_remove (&z->elem);
+  zpool_bytes -= z->size;
+  free (z);
+  return true;
+}
+
+/* Allocates CNT adjacent free slots.  Returns the first slot, or
+   BITMAP_ERROR if there is no such run.  Must be called with
+   swap_lock held. */
+static size_t
+alloc_slots (size_t cnt)
+{
+  size_t slot = bitmap_scan_and_flip (swap_bitmap, swap_hint, cnt, false);
+  if (slot == BITMAP_ERROR && swap_hint != 0)
+    slot = bitmap_scan_and_flip (swap_bitmap, 0, cnt, false);
+  if (slot != BITMAP_ERROR)
+    swap_hint = slot + cnt;
+  return slot;
+}
+
+/* Returns the only page in frame F, or a null pointer if F is
+   shared. */
+static struct page *
+frame_owner (struct frame *f)
+{
+  if (f->ref_cnt != 1)
+    return NULL;
+  return list_entry (list_front (&f->pages), struct page, frame_elem);
+}
+
+/* Writes as many as possible of the CNT frames in FRAMES to
+   swap, in order, and records each frame's slot in its pages.
+   The frames must be locked by the current thread.  Frames that
+   do not fit in the compressed pool and get adjacent slots are
+   written to disk with a single device request.  Returns the
+   number of frames written, which is less than CNT only if swap
+   is (nearly) full. */
+size_t
+swap_out (struct frame **frames, size_t cnt)
+{
+  struct block_iovec iov[SWAP_CLUSTER];
+  bool pooled[SWAP_CLUSTER];
+  size_t done = 0;
+
+  while (done < cnt)
+    {
+      size_t run = cnt - done;
+      size_t slot, i, j;
+
+      if (run > SWAP_CLUSTER)
+        run = SWAP_CLUSTER;
+
+      /* Find the longest run of free slots, up to RUN. */
+      lock_acquire (&swap_lock);
+      while ((slot = alloc_slots (run)) == BITMAP_ERROR && run > 1)
+        run /= 2;
+      if (slot != BITMAP_ERROR)
+        for (i = 0; i < run; i++)
+          {
+            swap_owners[slot + i] = frame_owner (frames[done + i]);
+            swap_ref_cnts[slot + i] = frames[done + i]->ref_cnt;
+            pooled[i] = zpool_store (slot + i, frames[done + i]->base);
+          }
+      lock_release (&swap_lock);
+      if (slot == BITMAP_ERROR)
+        break;
+
+      for (i = 0; i < run; i++)
+        {
+          struct frame *f = frames[done + i];
+          struct list_elem *e;
+
+          ASSERT (lock_held_by_current_thread (&f->lock));
+
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            list_entry (e, struct page, frame_elem)->sector
+              = (slot + i) * PAGE_SECTORS;
+          iov[i].buffer = f->base;
+          iov[i].sector_cnt = PAGE_SECTORS;
+        }
+
+      /* Write the runs of frames that are not in the pool. */
+      for (i = 0; i < run; i = j)
+        {
+          if (pooled[i])
+            {
+              j = i + 1;
+              continue;
+            }
+          for (j = i; j < run && !pooled[j]; j++)
+            continue;
+          block_writev (swap_device, (slot + i) * PAGE_SECTORS, iov + i,
+                        j - i);
+          out_req_cnt++;
+          out_page_cnt += j - i;
+        }
+      done += run;
+    }
+  return done;
+}
+
+/* Reads the CNT pages in PAGES, which must occupy adjacent swap
+   slots in order, back into their frames.  Pages in the
+   compressed pool are decompressed; the rest are read with as
+   few device requests as possible.  The pages' frames must be
+   locked by the current thread.  The slots stay allocated until
+   swap_discard(). */
+void
+swap_in (struct page **pages, size_t cnt)
+{
+  struct block_iovec iov[SWAP_CLUSTER];
+  bool on_disk[SWAP_CLUSTER];
+  size_t i, j;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+  /* A slot's contents only ever move from the pool to the disk,
+     and leave the pool, under swap_lock, only once they are on
+     the disk, so a slot not in the pool now stays on the disk
+     until it is freed. */
+  lock_acquire (&swap_lock);
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = pages[i];
+      struct zpage *z = swap_zpages[p->sector / PAGE_SECTORS];
+
+      ASSERT (p->frame != NULL);
+      ASSERT (lock_held_by_current_thread (&p->frame->lock));
+      ASSERT (p->sector == pages[0]->sector + i * PAGE_SECTORS);
+
+      iov[i].buffer = p->frame->base;
+      iov[i].sector_cnt = PAGE_SECTORS;
+      on_disk[i] = z == NULL;
+      if (z != NULL)
+        {
+          size_t size = lz_decompress (z->data, z->size, p->frame->base,
+                                       PGSIZE);
+          ASSERT (size == PGSIZE);
+          zpool_in_cnt++;
+        }
+    }
+  lock_release (&swap_lock);
+
+  for (i = 0; i < cnt; i = j)
+    {
+      if (!on_disk[i])
+        {
+          j = i + 1;
+          continue;
+        }
+      for (j = i; j < cnt && on_disk[j]; j++)
+        continue;
+      block_readv (swap_device, pages[i]->sector, iov + i, j - i);
+      in_req_cnt++;
+      in_page_cnt += j - i;
+    }
+}
+
+/* Drops page P's reference to its swap slot, freeing the slot
+   if no other page refers to it. */
+void
+swap_discard (struct page *p)
+{
+  size_t slot = p->sector / PAGE_SECTORS;
+
+  ASSERT (p->sector != (block_sector_t) -1);
+
+  lock_acquire (&swap_lock);
+  ASSERT (swap_owners[slot] == p || swap_owners[slot] == NULL);
+  ASSERT (swap_ref_cnts[slot] > 0);
+  if (--swap_ref_cnts[slot] == 0 && zpool_discard (slot))
+    bitmap_reset (swap_bitmap, slot);
+  swap_owners[slot] = NULL;
+  lock_release (&swap_lock);
+  p->sector = (block_sector_t) -1;
+}
+
+/* Makes page Q refer to the swap slot of page P as well. */
+void
+swap_share (struct page *p, struct page *q)
+{
+  size_t slot = p->sector / PAGE_SECTORS;
+
+  ASSERT (p->sector != (block_sector_t) -1);
+
+  lock_acquire (&swap_lock);
+  swap_ref_cnts[slot]++;
+  swap_owners[slot] = NULL;
+  lock_release (&swap_lock);
+  q->sector = p->sector;
+}
+
+/* Returns the page in the swap slot DELTA slots away from that
+   of page P, if that slot is in the same cluster and holds
+   another page of P's process.  Otherwise returns a null
+   pointer. */
+struct page *
+swap_neighbor (const struct page *p, int delta)
+{
+  size_t slot = p->sector / PAGE_SECTORS;
+  size_t other = slot + delta;
+  struct page *q = NULL;
+
+  ASSERT (p->sector != (block_sector_t) -1);
+
+  if (other / SWAP_CLUSTER != slot / SWAP_CLUSTER
+      || other >= bitmap_size (swap_bitmap))
+    return NULL;
+
+  lock_acquire (&swap_lock);
+  if (swap_owners[other] != NULL && swap_owners[other]->thread == p->thread)
+    q = swap_owners[other];
+  lock_release (&swap_lock);
+  return q;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %llu pages out in %llu requests, "
+          "%llu pages in in %llu requests\n",
+          out_page_cnt, out_req_cnt, in_page_cnt, in_req_cnt);
+  printf ("Swap: compressed pool %llu pages in, %llu out, "
+          "%llu rejected, %llu written back, %zu bytes held\n",
+          zpool_out_cnt, zpool_in_cnt, zpool_reject_cnt,
+          zpool_writeback_cnt, zpool_bytes);
+}
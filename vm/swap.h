@@ -0,0 +1,25 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+struct page;
+
+/* Number of adjacent swap slots in a cluster.  Also the largest
+   number of pages moved by one device request. */
+#define SWAP_CLUSTER 8
+
+/* -zs: Size limit of the compressed pool, in bytes. */
+extern size_t swap_pool_limit;
+
+void swap_init (void);
+size_t swap_out (struct frame **, size_t cnt);
+void swap_in (struct page **, size_t cnt);
+void swap_discard (struct page *);
+void swap_share (struct page *, struct page *);
+struct page *swap_neighbor (const struct page *, int delta);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */